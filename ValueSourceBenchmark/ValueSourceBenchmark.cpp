@@ -0,0 +1,292 @@
+//
+// Headless benchmark for the MovingObject designs shown off in the demo.
+//
+// Each design is instantiated at a range of population sizes and driven
+// through the same update loop as the demo's main(), minus the console.
+// Instead of rendering, every object's position is folded into a running
+// checksum so the optimizer cannot throw the work away.
+//
+// Usage: ValueSourceBenchmark [ticks] [max objects]
+//
+
+#include "MovingObjects.h"
+#include "StaticValueSource.h"
+#include "ValueSourceAccumulator.h"
+#include "ValueSourceAccumulatorBatch.h"
+#include "ValueSourceLinearInterpolator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+
+namespace
+{
+
+	//
+	// Process-wide high-water mark of resident memory, in megabytes.
+	// Since this never goes back down, runs are ordered by ascending
+	// population so each reading reflects the largest run so far.
+	//
+	double GetPeakResidentMegabytes ()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0.0;
+
+		return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0.0;
+
+#if defined(__APPLE__)
+		return static_cast<double>(usage.ru_maxrss) / (1024.0 * 1024.0);
+#else
+		return static_cast<double>(usage.ru_maxrss) / 1024.0;
+#endif
+#endif
+	}
+
+
+	//
+	// Deterministic starting conditions, so every design simulates the
+	// exact same population and the checksums can be compared. They
+	// agree up to float rounding: the accumulators sum their steps while
+	// the interpolator works each position out directly.
+	//
+	const float DT = 0.1f;
+
+	float GetStart (size_t index)
+	{
+		return static_cast<float>(index % 1000) * 0.01f;
+	}
+
+	float GetVelocity (size_t index)
+	{
+		return 1.0f + static_cast<float>(index % 7);
+	}
+
+
+	struct Result
+	{
+		double Seconds;
+		double Checksum;
+	};
+
+
+	template <typename TickFunction>
+	Result RunTicks (unsigned ticks, TickFunction tick)
+	{
+		Result result = { 0.0, 0.0 };
+		float time = 0.0f;
+
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < ticks; ++i)
+		{
+			time += DT;
+			result.Checksum += tick(time, DT);
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		result.Seconds = std::chrono::duration<double>(end - start).count();
+		return result;
+	}
+
+
+	Result RunClassic (size_t count, unsigned ticks)
+	{
+		std::vector<ClassicDesignDemo::MovingObject> objects;
+		objects.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+			objects.emplace_back(GetStart(i), GetVelocity(i));
+
+		return RunTicks(ticks, [&objects] (float, float dt)
+		{
+			double sum = 0.0;
+			for (auto & object : objects)
+			{
+				object.Advance(dt);
+				sum += object.GetPosition();
+			}
+			return sum;
+		});
+	}
+
+
+	//
+	// Value sources are allocated one by one, just like a game would
+	// create them as objects spawn, rather than packed into one array.
+	//
+	Result RunDynamicValueSource (size_t count, unsigned ticks)
+	{
+		std::vector<std::unique_ptr<ValueSourceLinearAccumulator>> sources;
+		std::vector<DynamicValueSourceDemo::MovingObject> objects(count);
+		sources.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			sources.emplace_back(new ValueSourceLinearAccumulator(GetStart(i), GetVelocity(i)));
+			objects[i].AttachPositionValueSource(sources.back().get());
+		}
+
+		return RunTicks(ticks, [&objects] (float, float dt)
+		{
+			double sum = 0.0;
+			for (auto & object : objects)
+			{
+				object.Advance(dt);
+				sum += object.GetPosition();
+			}
+			return sum;
+		});
+	}
+
+
+	//
+	// The dynamic value source design with the source type known at
+	// compile time, so the accumulator is embedded and fully inlined.
+	//
+	Result RunStaticDispatch (size_t count, unsigned ticks)
+	{
+		typedef StaticDispatchDemo::MovingObject<StaticValueSourceLinearAccumulator> Object;
+
+		std::vector<Object> objects;
+		objects.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+			objects.emplace_back(StaticValueSourceLinearAccumulator(GetStart(i), GetVelocity(i)));
+
+		return RunTicks(ticks, [&objects] (float, float dt)
+		{
+			double sum = 0.0;
+			for (auto & object : objects)
+			{
+				object.Advance(dt);
+				sum += object.GetPosition();
+			}
+			return sum;
+		});
+	}
+
+
+	//
+	// Each interpolator spans the whole run, covering the distance an
+	// accumulator travels in it, so the objects follow the same paths as
+	// in the other designs rather than stopping once t reaches one.
+	//
+	Result RunReactive (size_t count, unsigned ticks)
+	{
+		const float duration = DT * static_cast<float>(ticks);
+
+		std::vector<std::unique_ptr<ValueSourceLinearInterpolator>> sources;
+		std::vector<ReactiveProgrammingDemo::MovingObject> objects(count);
+		sources.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			sources.emplace_back(new ValueSourceLinearInterpolator(GetStart(i), GetStart(i) + GetVelocity(i) * duration));
+			objects[i].AttachPositionValueSource(sources.back().get());
+		}
+
+		return RunTicks(ticks, [&sources, &objects, duration] (float time, float)
+		{
+			for (auto & source : sources)
+				source->SetTime(time / duration);
+
+			double sum = 0.0;
+			for (auto & object : objects)
+				sum += object.GetPosition();
+			return sum;
+		});
+	}
+
+
+	//
+	// Same objects as the dynamic value source run, but attached to
+	// views of one batch. Objects attached to a batch have nothing to
+	// do in Advance(), so the tick steps the batch once and then only
+	// reads positions back through the objects.
+	//
+	Result RunBatchedAccumulator (size_t count, unsigned ticks)
+	{
+		ValueSourceLinearAccumulatorBatch batch;
+		batch.Reserve(count);
+		for (size_t i = 0; i < count; ++i)
+			batch.Add(GetStart(i), GetVelocity(i));
+
+		std::vector<ValueSourceLinearAccumulatorBatch::View> views;
+		std::vector<DynamicValueSourceDemo::MovingObject> objects(count);
+		views.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			views.push_back(batch.GetView(i));
+			objects[i].AttachPositionValueSource(&views.back());
+		}
+
+		return RunTicks(ticks, [&batch, &objects] (float, float dt)
+		{
+			batch.Advance(dt);
+
+			double sum = 0.0;
+			for (auto & object : objects)
+				sum += object.GetPosition();
+			return sum;
+		});
+	}
+
+
+	void Report (const char * design, size_t count, unsigned ticks, const Result & result)
+	{
+		const double objectticks = static_cast<double>(count) * ticks;
+		const double nanoseconds = result.Seconds * 1e9 / objectticks;
+		const double throughput = objectticks / result.Seconds / 1e6;
+
+		std::printf("%-22s %10zu %12.3f %14.2f %12.1f %16.6g\n",
+			design, count, nanoseconds, throughput, GetPeakResidentMegabytes(), result.Checksum);
+	}
+
+}
+
+
+int main (int argc, char * argv[])
+{
+	unsigned ticks = 100;
+	size_t maxobjects = 10000000;
+
+	if (argc > 1)
+		ticks = static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10));
+
+	if (argc > 2)
+		maxobjects = static_cast<size_t>(std::strtoull(argv[2], nullptr, 10));
+
+	if (ticks == 0)
+	{
+		std::fprintf(stderr, "Usage: %s [ticks] [max objects]\n", argv[0]);
+		return 1;
+	}
+
+	std::printf("%-22s %10s %12s %14s %12s %16s\n",
+		"design", "objects", "ns/obj/tick", "Mobj-ticks/s", "peak RSS MB", "checksum");
+
+	for (size_t count = 1000; count <= maxobjects; count *= 10)
+	{
+		Report("classic", count, ticks, RunClassic(count, ticks));
+		Report("dynamic value source", count, ticks, RunDynamicValueSource(count, ticks));
+		Report("static dispatch", count, ticks, RunStaticDispatch(count, ticks));
+		Report("reactive", count, ticks, RunReactive(count, ticks));
+		Report("batched accumulator", count, ticks, RunBatchedAccumulator(count, ticks));
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceSimd.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+
+//
+// Multi-buffered copies of the values of a population of sources, so
+// that reading them can overlap with advancing them.
+//
+// The simulation advances its sources for tick N+1 and captures their
+// values into the back buffer, while render, networking, telemetry and
+// anything else reads the tick N values out of the front buffer. At the
+// frame barrier, Flip() publishes the back buffer as the new front; it
+// swaps indices and copies nothing, so it costs the same at any count.
+//
+// With two buffers, readers must be done with a front buffer by the next
+// flip, which is the usual lockstep pipeline. Each extra buffer lets
+// readers lag one more flip behind: with three, a reader may still be
+// working on a front buffer after the flip that replaces it, and only
+// has to let go by the flip after that. Readers take the front buffer
+// once per pass with GetFront() so that everything they read comes from
+// the same tick.
+//
+// Only one thread should write and flip.
+//
+template <typename T, unsigned BufferCount = 2>
+class BufferedValueStore
+{
+	static_assert(BufferCount >= 2, "Buffered stores need at least a front and a back buffer");
+
+public:
+
+	//
+	// A consistent view of one tick's values.
+	//
+	struct Frame
+	{
+		const T * Values;
+		uint64_t Tick;
+	};
+
+
+	//
+	// One value read from whatever the front buffer is at the time, for
+	// attaching to objects that render between flips.
+	//
+	class View : public ValueSource<T>
+	{
+	public:
+		View (const BufferedValueStore & store, size_t index)
+			: Store(&store),
+			  Index(index)
+		{ }
+
+
+		T GetCurrentValue () const override
+		{
+			return Store->GetFront().Values[Index];
+		}
+
+	private:
+		const BufferedValueStore * Store;
+		size_t Index;
+	};
+
+
+	explicit BufferedValueStore (size_t count)
+		: Count(count),
+		  Stride(RoundToCacheLine(count)),
+		  Storage(Stride * BufferCount),
+		  Back(1)
+	{ }
+
+	BufferedValueStore (const BufferedValueStore &) = delete;
+	BufferedValueStore & operator = (const BufferedValueStore &) = delete;
+
+
+	size_t GetCount () const
+	{
+		return Count;
+	}
+
+	View GetView (size_t index) const
+	{
+		return View(*this, index);
+	}
+
+
+	//
+	// Writer side.
+	//
+	T * GetBackBuffer ()
+	{
+		return Storage.data() + Back * Stride;
+	}
+
+	void Write (size_t index, const T & value)
+	{
+		GetBackBuffer()[index] = value;
+	}
+
+	//
+	// Copy a range of sources' current values into the back buffer.
+	// Disjoint ranges may be captured in parallel. Batches can skip this
+	// and write their values with GetCurrentValues(first, count, out).
+	//
+	void Capture (size_t first, const ValueSource<T> * const * sources, size_t count)
+	{
+		T * out = GetBackBuffer() + first;
+		for (size_t i = 0; i < count; ++i)
+			out[i] = sources[i]->GetCurrentValue();
+	}
+
+
+	//
+	// Publish the back buffer and move on to the next one in the ring.
+	// The new back buffer starts out holding stale values from several
+	// ticks ago; callers are expected to overwrite all of it.
+	//
+	void Flip ()
+	{
+		uint64_t tick = Published.load(std::memory_order_relaxed) >> IndexBits;
+		Published.store(((tick + 1) << IndexBits) | Back, std::memory_order_release);
+
+		Back = (Back + 1) % BufferCount;
+	}
+
+
+	//
+	// Reader side. Tick counts flips since construction.
+	//
+	Frame GetFront () const
+	{
+		uint64_t published = Published.load(std::memory_order_acquire);
+
+		Frame frame;
+		frame.Values = Storage.data() + (published & IndexMask) * Stride;
+		frame.Tick = published >> IndexBits;
+		return frame;
+	}
+
+	const T & GetValue (size_t index) const
+	{
+		return GetFront().Values[index];
+	}
+
+
+	//
+	// The front buffer together with the one published before it, e.g.
+	// for blending between the last two ticks. That older buffer is the
+	// next one to be written, so with two buffers it is only valid until
+	// the writer starts on the next tick; readers that run alongside the
+	// writer need three. Before the second flip there is no older tick,
+	// and both frames are the front.
+	//
+	void GetFrames (Frame & previous, Frame & current) const
+	{
+		uint64_t published = Published.load(std::memory_order_acquire);
+		uint64_t index = published & IndexMask;
+
+		current.Values = Storage.data() + index * Stride;
+		current.Tick = published >> IndexBits;
+
+		if (current.Tick < 2)
+		{
+			previous = current;
+			return;
+		}
+
+		previous.Values = Storage.data() + ((index + BufferCount - 1) % BufferCount) * Stride;
+		previous.Tick = current.Tick - 1;
+	}
+
+private:
+	static const unsigned IndexBits = 8;
+	static const uint64_t IndexMask = (1u << IndexBits) - 1;
+
+	static_assert(BufferCount <= IndexMask, "Too many buffers");
+
+
+	//
+	// Each buffer starts on its own cache line, so the writer filling
+	// the back buffer never shares a line with a reader of the front.
+	//
+	static size_t RoundToCacheLine (size_t count)
+	{
+		const size_t perline = ValueSourceCacheLineSize / sizeof(T) ? ValueSourceCacheLineSize / sizeof(T) : 1;
+		return (count + perline - 1) / perline * perline;
+	}
+
+
+	size_t Count;
+	size_t Stride;
+	std::vector<T, AlignedAllocator<T>> Storage;
+
+	unsigned Back;
+
+	// Front buffer index in the low bits, flip count above them, so a
+	// reader gets both from a single load.
+	std::atomic<uint64_t> Published{ 0 };
+};
+
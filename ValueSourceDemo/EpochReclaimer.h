@@ -0,0 +1,175 @@
+#pragma once
+
+#include "ValueSourceSimd.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+//
+// Epoch-based reclamation, for freeing objects that other threads may
+// still be reading without making those readers take a lock.
+//
+// Readers register once for a slot, then wrap each pass over shared
+// objects in a Guard, which publishes the global epoch they entered in.
+// A writer unlinks an object from wherever readers find it and retires
+// it, tagging it with the current epoch. Once every reader inside a
+// guard entered after that epoch, nobody can still be holding the
+// object, and it is deleted.
+//
+// Entering and leaving a guard are one store each, and never wait on
+// anything. Only retiring takes a lock, and then only against other
+// retiring threads.
+//
+class EpochReclaimer
+{
+public:
+	explicit EpochReclaimer (unsigned maxthreads = 64)
+		: Slots(maxthreads),
+		  RegisteredSlots(0),
+		  GlobalEpoch(1)
+	{ }
+
+	~EpochReclaimer ()
+	{
+		for (auto & retired : Retired)
+			retired.Delete(retired.Object);
+	}
+
+	EpochReclaimer (const EpochReclaimer &) = delete;
+	EpochReclaimer & operator = (const EpochReclaimer &) = delete;
+
+
+	//
+	// Each reading thread needs its own slot, for the life of the
+	// reclaimer.
+	//
+	unsigned RegisterThread ()
+	{
+		unsigned slot = RegisteredSlots.fetch_add(1);
+		assert(slot < Slots.size());
+		return slot;
+	}
+
+
+	//
+	// Marks a thread as reading for as long as it lives. Guards on the
+	// same slot must not be nested.
+	//
+	class Guard
+	{
+	public:
+		Guard (EpochReclaimer & reclaimer, unsigned slot)
+			: Epoch(reclaimer.Slots[slot].Epoch)
+		{
+			Epoch.store(reclaimer.GlobalEpoch.load());
+		}
+
+		~Guard ()
+		{
+			Epoch.store(0, std::memory_order_release);
+		}
+
+		Guard (const Guard &) = delete;
+		Guard & operator = (const Guard &) = delete;
+
+	private:
+		std::atomic<uint64_t> & Epoch;
+	};
+
+
+	//
+	// Hand over an object that has already been unlinked, to be deleted
+	// once no reader can still see it. Retiring also frees whatever
+	// earlier retirements have become safe to free.
+	//
+	template <typename Object>
+	void Retire (Object * object)
+	{
+		if (!object)
+			return;
+
+		std::lock_guard<std::mutex> lock(Mutex);
+
+		RetiredObject retired = { object, &DeleteObject<Object>, GlobalEpoch.load() };
+		Retired.push_back(retired);
+		CollectLocked();
+	}
+
+	void Collect ()
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		CollectLocked();
+	}
+
+
+	size_t GetRetiredCount () const
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		return Retired.size();
+	}
+
+private:
+	struct RetiredObject
+	{
+		void * Object;
+		void (*Delete) (void *);
+		uint64_t Epoch;
+	};
+
+	struct Slot
+	{
+		std::atomic<uint64_t> Epoch{ 0 };
+		char Padding[ValueSourceCacheLineSize - sizeof(std::atomic<uint64_t>)];
+	};
+
+
+	template <typename Object>
+	static void DeleteObject (void * object)
+	{
+		delete static_cast<Object *>(object);
+	}
+
+
+	//
+	// Moving the epoch on first means any reader entering from here on
+	// is known to have started after everything retired so far.
+	//
+	void CollectLocked ()
+	{
+		GlobalEpoch.fetch_add(1);
+
+		uint64_t oldest = UINT64_MAX;
+		const unsigned registered = RegisteredSlots.load();
+		for (unsigned i = 0; i < registered && i < Slots.size(); ++i)
+		{
+			uint64_t epoch = Slots[i].Epoch.load();
+			if (epoch && epoch < oldest)
+				oldest = epoch;
+		}
+
+		size_t kept = 0;
+		for (size_t i = 0; i < Retired.size(); ++i)
+		{
+			if (Retired[i].Epoch < oldest)
+				Retired[i].Delete(Retired[i].Object);
+			else
+				Retired[kept++] = Retired[i];
+		}
+
+		Retired.resize(kept);
+	}
+
+
+	std::vector<Slot, AlignedAllocator<Slot>> Slots;
+	std::atomic<unsigned> RegisteredSlots;
+	std::atomic<uint64_t> GlobalEpoch;
+
+	mutable std::mutex Mutex;
+	std::vector<RetiredObject> Retired;
+};
+
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "BufferedValueStore.h"
+#include "ValueSourceSimd.h"
+
+#include <cassert>
+#include <vector>
+
+
+//
+// Blend two arrays of values: out = previous + (current - previous) * alpha.
+// The arrays need no particular alignment; on aligned storage, such as
+// the store's, the unaligned loads cost nothing extra.
+//
+inline void ValueSourceBlend (const float * previous, const float * current, float alpha, float * out, size_t count)
+{
+	size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+	const __m256 alpha8 = _mm256_set1_ps(alpha);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 p = _mm256_loadu_ps(previous + i);
+		__m256 c = _mm256_loadu_ps(current + i);
+		_mm256_storeu_ps(out + i, _mm256_add_ps(p, _mm256_mul_ps(_mm256_sub_ps(c, p), alpha8)));
+	}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+	const __m128 alpha4 = _mm_set1_ps(alpha);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 p = _mm_loadu_ps(previous + i);
+		__m128 c = _mm_loadu_ps(current + i);
+		_mm_storeu_ps(out + i, _mm_add_ps(p, _mm_mul_ps(_mm_sub_ps(c, p), alpha4)));
+	}
+#endif
+
+	for (; i < count; ++i)
+		out[i] = previous[i] + (current[i] - previous[i]) * alpha;
+}
+
+
+//
+// Runs a simulation at a fixed rate, independent of how often frames are
+// presented.
+//
+// Each frame reports how much real time has passed. That time is banked,
+// and as many whole simulation steps as it covers are run, each one
+// capturing every object's value into a BufferedValueStore. What is left
+// over is a fraction of a step, and presenting the objects blended that
+// far between their last two simulated values keeps motion smooth at any
+// frame rate, even one far above the simulation rate. The price is that
+// what is shown trails the simulation by up to one step.
+//
+// Steps per frame are capped, so that a simulation which can't keep up
+// slows down rather than spiralling into ever longer frames.
+//
+class FixedTimestep
+{
+public:
+	FixedTimestep (float step, size_t count, unsigned maxstepsperframe = 8)
+		: Step(step),
+		  MaxSteps(maxstepsperframe),
+		  Accumulated(0.0f),
+		  Store(count),
+		  Blended(count)
+	{
+		assert(step > 0.0f);
+	}
+
+
+	float GetStep () const
+	{
+		return Step;
+	}
+
+	size_t GetCount () const
+	{
+		return Store.GetCount();
+	}
+
+
+	//
+	// Record the starting values, as capture(values), so that the first
+	// step has something to be blended from.
+	//
+	template <typename CaptureFunction>
+	void Prime (CaptureFunction capture)
+	{
+		capture(Store.GetBackBuffer());
+		Store.Flip();
+	}
+
+
+	//
+	// Bank a frame's worth of time and run whatever steps it pays for.
+	// The step function is called as step(dt, values), and should
+	// advance the simulation by dt and then write every object's value
+	// to values. Returns the number of steps run.
+	//
+	template <typename StepFunction>
+	unsigned Update (float frametime, StepFunction step)
+	{
+		Accumulated += frametime;
+
+		unsigned steps = 0;
+		while (Accumulated >= Step && steps < MaxSteps)
+		{
+			step(Step, Store.GetBackBuffer());
+			Store.Flip();
+
+			Accumulated -= Step;
+			++steps;
+		}
+
+		if (Accumulated > Step)
+			Accumulated = Step;
+
+		return steps;
+	}
+
+
+	//
+	// How far presentation sits between the last two steps, in [0, 1].
+	//
+	float GetAlpha () const
+	{
+		return Accumulated / Step;
+	}
+
+
+	//
+	// Blend the last two steps by the current alpha, in one vectorized
+	// pass, and return the blended values. They stay valid until the
+	// next call.
+	//
+	const float * Interpolate ()
+	{
+		BufferedValueStore<float, 2>::Frame previous, current;
+		Store.GetFrames(previous, current);
+
+		ValueSourceBlend(previous.Values, current.Values, GetAlpha(), Blended.data(), Store.GetCount());
+		return Blended.data();
+	}
+
+	//
+	// The latest simulated values, without blending.
+	//
+	const float * GetCurrentValues () const
+	{
+		return Store.GetFront().Values;
+	}
+
+private:
+	float Step;
+	unsigned MaxSteps;
+	float Accumulated;
+
+	BufferedValueStore<float, 2> Store;
+	std::vector<float, AlignedAllocator<float>> Blended;
+};
+
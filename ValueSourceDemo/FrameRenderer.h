@@ -0,0 +1,274 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+
+//
+// Output stage for rendering a whole frame of objects at once.
+//
+// Streaming each object's line through std::cout and std::endl flushes
+// once per object, and at any real object count that flushing is what
+// the tick spends its time on. A FrameRenderer instead formats the frame
+// into a reusable buffer and hands it to the OS in a single write call
+// when the frame ends. Once the buffers have grown to the size of a
+// frame, rendering allocates nothing.
+//
+// Text mode produces the same lines the demo has always printed. Binary
+// mode is meant for machine consumers: each frame is a FrameHeader
+// followed by one float per object, in the order they were appended.
+//
+// With an asynchronous renderer, finished frames are queued for a writer
+// thread, so the simulation does not wait on a slow stdout. It only ever
+// blocks if every one of the frame buffers is still waiting to be written.
+//
+class FrameRenderer
+{
+public:
+	enum class Mode
+	{
+		Text,
+		Binary
+	};
+
+	struct FrameHeader
+	{
+		uint32_t Magic;
+		uint32_t Count;
+		float Time;
+	};
+
+	static const uint32_t FrameMagic = 0x52465356;		// "VSFR"
+
+
+	FrameRenderer (FILE * output, Mode mode, bool async = false, unsigned buffers = 4)
+		: Output(output),
+		  OutputMode(mode),
+		  Async(async),
+		  Current(nullptr),
+		  Count(0),
+		  Stopping(false)
+	{
+		if (buffers < 2)
+			buffers = 2;
+
+		Buffers.resize(Async ? buffers : 1);
+		Ready.reserve(Buffers.size());
+		for (auto & buffer : Buffers)
+			Free.push_back(&buffer);
+
+		if (Async)
+			Writer = std::thread(&FrameRenderer::WriterLoop, this);
+	}
+
+	~FrameRenderer ()
+	{
+		if (Async)
+		{
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				Stopping = true;
+			}
+			Wake.notify_all();
+			Writer.join();
+		}
+	}
+
+	FrameRenderer (const FrameRenderer &) = delete;
+	FrameRenderer & operator = (const FrameRenderer &) = delete;
+
+
+	void BeginFrame (float time)
+	{
+		Current = AcquireBuffer();
+		Current->Used = 0;
+		Count = 0;
+
+		if (OutputMode == Mode::Text)
+		{
+			AppendText("Tick at ", time);
+		}
+		else
+		{
+			FrameHeader header = { FrameMagic, 0, time };
+			AppendBytes(&header, sizeof(header));
+		}
+	}
+
+	void Append (const char * label, float value)
+	{
+		if (OutputMode == Mode::Text)
+			AppendText(label, value);
+		else
+			AppendBytes(&value, sizeof(value));
+
+		++Count;
+	}
+
+	void EndFrame ()
+	{
+		if (OutputMode == Mode::Binary)
+			std::memcpy(Current->Data.data() + offsetof(FrameHeader, Count), &Count, sizeof(Count));
+
+		if (!Async)
+		{
+			WriteBuffer(*Current);
+			Free.push_back(Current);
+		}
+		else
+		{
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				Ready.push_back(Current);
+			}
+			Wake.notify_all();
+		}
+
+		Current = nullptr;
+	}
+
+private:
+	struct Buffer
+	{
+		std::vector<char> Data;
+		size_t Used = 0;
+	};
+
+
+	char * Reserve (size_t bytes)
+	{
+		if (Current->Used + bytes > Current->Data.size())
+			Current->Data.resize((Current->Used + bytes) * 2);
+
+		return Current->Data.data() + Current->Used;
+	}
+
+	void AppendBytes (const void * bytes, size_t size)
+	{
+		std::memcpy(Reserve(size), bytes, size);
+		Current->Used += size;
+	}
+
+	//
+	// Formats like the default iostream precision, so the text output
+	// is unchanged from what the objects used to print themselves. The
+	// number goes through snprintf rather than std::to_chars, whose float
+	// overloads the v141 standard library doesn't have.
+	//
+	void AppendText (const char * label, float value)
+	{
+		const size_t labellength = std::strlen(label);
+		const size_t maxnumber = 32;
+
+		char * out = Reserve(labellength + maxnumber + 1);
+		std::memcpy(out, label, labellength);
+
+		char * number = out + labellength;
+		int numberlength = std::snprintf(number, maxnumber, "%g", value);
+		number[numberlength] = '\n';
+
+		Current->Used += labellength + static_cast<size_t>(numberlength) + 1;
+	}
+
+
+	Buffer * AcquireBuffer ()
+	{
+		if (!Async)
+		{
+			Buffer * buffer = Free.back();
+			Free.pop_back();
+			return buffer;
+		}
+
+		std::unique_lock<std::mutex> lock(Mutex);
+		Recycled.wait(lock, [this] { return !Free.empty(); });
+
+		Buffer * buffer = Free.back();
+		Free.pop_back();
+		return buffer;
+	}
+
+
+	//
+	// One write per frame. Anything already sitting in the stdio buffer
+	// goes out first so the two don't interleave.
+	//
+	void WriteBuffer (const Buffer & buffer)
+	{
+		std::fflush(Output);
+
+		const char * data = buffer.Data.data();
+		size_t remaining = buffer.Used;
+		while (remaining > 0)
+		{
+#if defined(_WIN32)
+			int written = _write(_fileno(Output), data, static_cast<unsigned>(remaining));
+#else
+			ssize_t written = ::write(fileno(Output), data, remaining);
+#endif
+			if (written <= 0)
+				break;
+
+			data += written;
+			remaining -= static_cast<size_t>(written);
+		}
+	}
+
+
+	void WriterLoop ()
+	{
+		for (;;)
+		{
+			Buffer * buffer = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(Mutex);
+				Wake.wait(lock, [this] { return Stopping || !Ready.empty(); });
+
+				if (Ready.empty())
+					return;
+
+				buffer = Ready.front();
+				Ready.erase(Ready.begin());
+			}
+
+			WriteBuffer(*buffer);
+
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				Free.push_back(buffer);
+			}
+			Recycled.notify_one();
+		}
+	}
+
+
+	FILE * Output;
+	Mode OutputMode;
+	bool Async;
+
+	std::deque<Buffer> Buffers;
+	Buffer * Current;
+	uint32_t Count;
+
+	std::vector<Buffer *> Free;
+	std::vector<Buffer *> Ready;
+	std::mutex Mutex;
+	std::condition_variable Wake;
+	std::condition_variable Recycled;
+	std::thread Writer;
+	bool Stopping;
+};
+
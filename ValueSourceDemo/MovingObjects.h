@@ -0,0 +1,458 @@
+#pragma once
+
+#include "EpochReclaimer.h"
+#include "FrameRenderer.h"
+#include "ValueSource.h"
+#include "ValueSourceArena.h"
+#include "StaticValueSource.h"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+
+
+//
+// Everything in this namespace relies on a concept of "dynamic value sources."
+//
+// See the ValueSource.h header for details on what this entails. The fundamental
+// process of updating an object should look very familiar: the world should call
+// into Advance() to update state, and then it can query that state to perform an
+// operation like Render().
+//
+namespace DynamicValueSourceDemo
+{
+
+	//
+	// A simple 1-axis game object. Moves over time.
+	//
+	// Note how we have to specifically "Advance" time here to move
+	// the simulation forwards. This is a common game architectural
+	// pattern. However, note that we don't store any data internal
+	// to the object itself, just a pointer to something that will,
+	// as needed, "feed" us that data.
+	//
+	class MovingObject
+	{
+	public:
+
+		//
+		// Decouple the position of our object from the object itself.
+		// This is a useful way to allow any kind of motion to control
+		// the object, such as a spline, spring oscillator, or even an
+		// entirely custom piece of code (or external script)!
+		//
+		void AttachPositionValueSource (DynamicValueSource<float> * position)
+		{
+			Position = position;
+		}
+
+		//
+		// Traditional game advancement routine, except instead of doing
+		// any complex operations ourselves, we delegate to the attached
+		// value source. Again, this allows any kind of controller to be
+		// driving the movement of this object, with no strong coupling.
+		//
+		void Advance (float dt)
+		{
+			if (Position)
+				Position->Advance(dt);
+		}
+
+		//
+		// Query the current position without drawing anything, e.g. for
+		// headless runs. Unattached objects sit at the origin.
+		//
+		float GetPosition () const
+		{
+			return Position ? Position->GetCurrentValue() : 0.0f;
+		}
+
+		//
+		// Display a representation of this game object on the console.
+		//
+		void Render ()
+		{
+			if (Position)
+				std::cout << "Value-source object position: " << Position->GetCurrentValue() << std::endl;
+		}
+
+		//
+		// Same again, but as part of a batched frame.
+		//
+		void Render (FrameRenderer & renderer)
+		{
+			if (Position)
+				renderer.Append("Value-source object position: ", Position->GetCurrentValue());
+		}
+
+	private:
+		DynamicValueSource<float> * Position = nullptr;
+	};
+
+}
+
+
+//
+// This is an example of how classical "reactive programming" can be done
+// using the value source concept. Note the lack of specific update code.
+// Instead, we drive the "data stream" separately, as illustrated by main
+// below.
+//
+namespace ReactiveProgrammingDemo
+{
+
+	//
+	// Again a simple game object. Note the lack of Advance().
+	//
+	class MovingObject
+	{
+	public:
+
+		//
+		// This function lets us decouple the data stream used to feed the
+		// position of this object from the object itself. Note that time
+		// is explicitly driven *outside* this object, not by an Advance()
+		// loop. This allows for things like rewinding time!
+		//
+		void AttachPositionValueSource (ValueSource<float> * position)
+		{
+			Position = position;
+		}
+
+		//
+		// Query the current position without drawing anything, e.g. for
+		// headless runs. Unattached objects sit at the origin.
+		//
+		float GetPosition () const
+		{
+			return Position ? Position->GetCurrentValue() : 0.0f;
+		}
+
+		//
+		// Display our game object on the console.
+		//
+		void Render ()
+		{
+			if (Position)
+				std::cout << "Reactive programming object position: " << Position->GetCurrentValue() << std::endl;
+		}
+
+		//
+		// Same again, but as part of a batched frame.
+		//
+		void Render (FrameRenderer & renderer)
+		{
+			if (Position)
+				renderer.Append("Reactive programming object position: ", Position->GetCurrentValue());
+		}
+
+	private:
+		ValueSource<float> * Position = nullptr;
+	};
+
+}
+
+
+//
+// If the stuff above was too weird, here's a breath of fresh, sane air.
+//
+// This is exactly how most games would implement a moving object. You give
+// the object some initial state, periodically advance the state by some time
+// step, and then display the results at your leisure.
+//
+namespace ClassicDesignDemo
+{
+
+	//
+	// Still just a simple game object.
+	//
+	class MovingObject
+	{
+	public:
+		//
+		// Note that we need to construct oursleves with some initial state.
+		//
+		MovingObject (float start, float velocity)
+		{
+			Position = start;
+			Velocity = velocity;
+		}
+
+		//
+		// Advancing pretty much looks like you'd expect.
+		//
+		void Advance (float dt)
+		{
+			Position += Velocity * dt;
+		}
+
+		//
+		// Query the current position without drawing anything.
+		//
+		float GetPosition () const
+		{
+			return Position;
+		}
+
+		//
+		// And, as usual, here's our way to draw onto the console.
+		//
+		void Render ()
+		{
+			std::cout << "Classic object position: " << Position << std::endl;
+		}
+
+		//
+		// Same again, but as part of a batched frame.
+		//
+		void Render (FrameRenderer & renderer)
+		{
+			renderer.Append("Classic object position: ", Position);
+		}
+
+	private:
+		float Position;
+		float Velocity;
+	};
+
+}
+
+
+//
+// The dynamic value source design again, but resolved at compile time.
+//
+// The object is templated on the concrete type of its position source
+// and embeds it directly. Every Advance() and GetCurrentValue() is then
+// a plain inlinable call, so a loop over many such objects compiles to
+// the same code as the classic design while keeping motion decoupled
+// from the object. When runtime swapping is genuinely needed, use the
+// StaticValueSourceFromVirtual adapter as the position source.
+//
+namespace StaticDispatchDemo
+{
+
+	template <typename PositionSource>
+	class MovingObject
+	{
+		static_assert(IsStaticValueSource<PositionSource>::value, "Static dispatch objects take a static value source; wrap virtual ones in StaticValueSourceFromVirtual");
+
+	public:
+		explicit MovingObject (const PositionSource & position)
+			: Position(position)
+		{ }
+
+		//
+		// Direct access to the embedded source, e.g. to drive the time
+		// of a reactive source or to attach an adapted virtual source.
+		//
+		PositionSource & GetPositionValueSource ()
+		{
+			return Position;
+		}
+
+		//
+		// Only instantiated for sources that can actually be advanced.
+		//
+		void Advance (float dt)
+		{
+			Position.Advance(dt);
+		}
+
+		float GetPosition () const
+		{
+			return Position.GetCurrentValue();
+		}
+
+		void Render ()
+		{
+			std::cout << "Static dispatch object position: " << Position.GetCurrentValue() << std::endl;
+		}
+
+		//
+		// Same again, but as part of a batched frame.
+		//
+		void Render (FrameRenderer & renderer)
+		{
+			renderer.Append("Static dispatch object position: ", Position.GetCurrentValue());
+		}
+
+	private:
+		PositionSource Position;
+	};
+
+}
+
+
+//
+// The dynamic value source design once more, with the source owned by a
+// ValueSourceArena.
+//
+// The object keeps a 4-byte handle instead of a pointer, so it neither
+// owns its source nor can silently outlive it, and a large population of
+// objects stays small. Anything that needs the position is handed the
+// arena to resolve the handle against. The arena advances every source
+// it owns in one pass, so these objects have no Advance() of their own.
+//
+namespace ArenaDemo
+{
+
+	class MovingObject
+	{
+	public:
+		void AttachPositionValueSource (ValueSourceHandle position)
+		{
+			Position = position;
+		}
+
+		ValueSourceHandle GetPositionValueSource () const
+		{
+			return Position;
+		}
+
+		float GetPosition (const ValueSourceArena<float> & arena) const
+		{
+			return Position.IsNull() ? 0.0f : arena.Get(Position).GetCurrentValue();
+		}
+
+		void Render (const ValueSourceArena<float> & arena)
+		{
+			if (!Position.IsNull())
+				std::cout << "Arena object position: " << arena.Get(Position).GetCurrentValue() << std::endl;
+		}
+
+		//
+		// Same again, but as part of a batched frame.
+		//
+		void Render (const ValueSourceArena<float> & arena, FrameRenderer & renderer)
+		{
+			if (!Position.IsNull())
+				renderer.Append("Arena object position: ", arena.Get(Position).GetCurrentValue());
+		}
+
+	private:
+		ValueSourceHandle Position;
+	};
+
+}
+
+
+//
+// The dynamic value source design, for objects whose source may be
+// swapped while other threads are advancing and rendering them.
+//
+// The source pointer is atomic, so a swap is a single exchange that
+// readers either see or don't; nobody waits on anybody. The source that
+// was swapped out may still be in use on another thread, so instead of
+// deleting it the object retires it to an EpochReclaimer, which frees
+// it once every reader has moved on. Every call on these objects has to
+// happen inside an EpochReclaimer::Guard for that to hold.
+//
+// Objects own their sources, which are handed over as unique_ptrs.
+//
+namespace ConcurrentValueSourceDemo
+{
+
+	class MovingObject
+	{
+	public:
+		explicit MovingObject (EpochReclaimer & reclaimer)
+			: Reclaimer(&reclaimer),
+			  Position(nullptr),
+			  Pending(nullptr)
+		{ }
+
+		//
+		// Nothing may be reading the object by the time it is destroyed.
+		//
+		~MovingObject ()
+		{
+			delete Position.load();
+			delete Pending.load();
+		}
+
+		MovingObject (const MovingObject &) = delete;
+		MovingObject & operator = (const MovingObject &) = delete;
+
+
+		//
+		// Switch to a new source immediately, from any thread. Passing
+		// null detaches. Also cancels any hand-off still pending.
+		//
+		void AttachPositionValueSource (std::unique_ptr<DynamicValueSource<float>> position)
+		{
+			delete Pending.exchange(nullptr);
+			Reclaimer->Retire(Position.exchange(position.release()));
+		}
+
+		void DetachPositionValueSource ()
+		{
+			AttachPositionValueSource(nullptr);
+		}
+
+		//
+		// Switch to a new source that carries on from the current value.
+		//
+		// Reading the old source's value on the swapping thread would
+		// race with the tick advancing it, so the switch is queued and
+		// made by the next Advance() instead, between one step and the
+		// next. A second hand-off before then replaces the first.
+		//
+		void HandOffPositionValueSource (std::unique_ptr<DynamicValueSource<float>> position)
+		{
+			delete Pending.exchange(position.release());
+		}
+
+
+		void Advance (float dt)
+		{
+			if (Pending.load(std::memory_order_relaxed))
+				ApplyHandOff();
+
+			DynamicValueSource<float> * position = Position.load();
+			if (position)
+				position->Advance(dt);
+		}
+
+		float GetPosition () const
+		{
+			DynamicValueSource<float> * position = Position.load();
+			return position ? position->GetCurrentValue() : 0.0f;
+		}
+
+		void Render ()
+		{
+			DynamicValueSource<float> * position = Position.load();
+			if (position)
+				std::cout << "Concurrent object position: " << position->GetCurrentValue() << std::endl;
+		}
+
+		//
+		// Same again, but as part of a batched frame.
+		//
+		void Render (FrameRenderer & renderer)
+		{
+			DynamicValueSource<float> * position = Position.load();
+			if (position)
+				renderer.Append("Concurrent object position: ", position->GetCurrentValue());
+		}
+
+	private:
+		void ApplyHandOff ()
+		{
+			DynamicValueSource<float> * next = Pending.exchange(nullptr);
+			if (!next)
+				return;
+
+			DynamicValueSource<float> * current = Position.load();
+			if (current)
+				next->SetCurrentValue(current->GetCurrentValue());
+
+			Reclaimer->Retire(Position.exchange(next));
+		}
+
+		EpochReclaimer * Reclaimer;
+		std::atomic<DynamicValueSource<float> *> Position;
+		std::atomic<DynamicValueSource<float> *> Pending;
+	};
+
+}
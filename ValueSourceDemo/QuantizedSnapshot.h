@@ -0,0 +1,670 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceBatchQuery.h"
+#include "ValueSourceSimd.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+
+//
+// Compact snapshots of a whole world's values, for replication and save
+// states.
+//
+// Each value is quantized to an integer of a configurable number of bits
+// spread evenly over a configurable range, so precision is traded for
+// size up front, e.g. 16 bits over a 1 km range is 1.5 cm. Values are
+// then bit-packed in blocks of 256, each block using only as many bits
+// as its largest code needs.
+//
+// A snapshot can also be encoded as the difference from an earlier one,
+// the baseline, that the other side is known to hold. Differences are
+// zigzag encoded so that small steps either way become small codes, and
+// blocks where nothing moved shrink to a single byte of header.
+//
+// Packing uses the "vertical" layout of SIMD bit-packing schemes: the
+// eight values of each group of eight go to eight interleaved streams of
+// words, so eight values are shifted into place with one instruction and
+// no value ever has to be split across lanes. The byte layout is the
+// same whatever instruction set did the packing, and every stage runs a
+// block at a time in stack buffers, so a snapshot goes from sources to
+// packed bytes, and back, in a single pass over memory.
+//
+// Quantized values are exact, so the encoder can hand back the codes it
+// sent and the decoder the codes it received; each side keeps those as
+// the baseline for later snapshots, and both always agree on it.
+//
+class QuantizedSnapshotCodec
+{
+public:
+	static const size_t BlockSize = 256;
+	static const unsigned MaxBits = 24;
+
+
+	//
+	// Values outside [min, max] are clamped to it. At most 24 bits are
+	// useful, since that is all the precision a float has.
+	//
+	QuantizedSnapshotCodec (float min, float max, unsigned bits)
+		: Min(min),
+		  Max(max),
+		  Bits(bits),
+		  MaxCode(static_cast<float>((1u << bits) - 1)),
+		  Scale(MaxCode / (max - min)),
+		  Step((max - min) / MaxCode)
+	{
+		assert(bits >= 1 && bits <= MaxBits);
+		assert(max > min);
+	}
+
+
+	unsigned GetBits () const
+	{
+		return Bits;
+	}
+
+	//
+	// The largest a snapshot of count values can encode to, for sizing
+	// the output buffer.
+	//
+	static size_t GetMaxEncodedSize (size_t count)
+	{
+		const size_t blocks = GetBlockCount(count);
+		return sizeof(Header) + GetWidthTableSize(blocks) + blocks * MaxBlockBytes;
+	}
+
+
+	//
+	// Encode count values into out, which must hold GetMaxEncodedSize()
+	// bytes, returning the size actually used. With a baseline, of count
+	// codes, the snapshot is encoded relative to it. If quantized is given
+	// it receives this snapshot's codes, ready to serve as a baseline.
+	//
+	size_t Encode (const float * values, size_t count, const uint32_t * baseline, uint32_t * quantized, unsigned char * out) const
+	{
+		return EncodeBlocks(count, baseline, quantized, out, [values] (size_t first, size_t, float *)
+		{
+			return values + first;
+		});
+	}
+
+	size_t Encode (const ValueSource<float> * const * sources, size_t count, const uint32_t * baseline, uint32_t * quantized, unsigned char * out) const
+	{
+		return EncodeBlocks(count, baseline, quantized, out, [sources] (size_t first, size_t n, float * block)
+		{
+			GetCurrentValues(sources + first, n, block);
+			return static_cast<const float *>(block);
+		});
+	}
+
+	//
+	// Any batch with a GetCurrentValues() overload, streamed straight out
+	// of its arrays.
+	//
+	template <typename Batch>
+	size_t EncodeBatch (const Batch & batch, size_t count, const uint32_t * baseline, uint32_t * quantized, unsigned char * out) const
+	{
+		return EncodeBlocks(count, baseline, quantized, out, [&batch] (size_t first, size_t n, float * block)
+		{
+			GetCurrentValues(batch, first, n, block);
+			return static_cast<const float *>(block);
+		});
+	}
+
+
+	//
+	// Decode a snapshot of count values, against the same baseline it was
+	// encoded with. Returns false, leaving the outputs undefined, if the
+	// data is malformed or doesn't match this codec, the count or the use
+	// of a baseline.
+	//
+	bool Decode (const unsigned char * data, size_t size, size_t count, const uint32_t * baseline, float * values, uint32_t * quantized = nullptr) const
+	{
+		Header header;
+		if (size < sizeof(header))
+			return false;
+
+		std::memcpy(&header, data, sizeof(header));
+		if (header.Magic != Magic || header.Count != count || header.Bits != Bits || header.Min != Min || header.Max != Max)
+			return false;
+
+		if ((header.Delta != 0) != (baseline != nullptr))
+			return false;
+
+		const size_t blocks = GetBlockCount(count);
+		if (size - sizeof(header) < GetWidthTableSize(blocks))
+			return false;
+
+		const unsigned char * widths = data + sizeof(header);
+		const unsigned maxwidth = baseline ? Bits + 1 : Bits;
+		size_t packed = 0;
+		for (size_t block = 0; block < blocks; ++block)
+		{
+			if (widths[block] > maxwidth)
+				return false;
+
+			packed += GetPackedSize(widths[block]);
+		}
+
+		if (size - sizeof(header) - GetWidthTableSize(blocks) < packed)
+			return false;
+
+		const unsigned char * in = widths + GetWidthTableSize(blocks);
+
+		alignas(ValueSourceCacheLineSize) uint32_t codes[BlockSize];
+
+		for (size_t b = 0; b < blocks; ++b)
+		{
+			const size_t first = b * BlockSize;
+			const size_t n = count - first < BlockSize ? count - first : BlockSize;
+			const unsigned width = widths[b];
+
+			Unpack(in, width, codes);
+			in += GetPackedSize(width);
+
+			if (baseline)
+				ApplyDelta(baseline + first, n, codes);
+
+			if (quantized)
+				std::memcpy(quantized + first, codes, n * sizeof(uint32_t));
+
+			Dequantize(codes, n, values + first);
+		}
+
+		return true;
+	}
+
+
+	//
+	// The value a code stands for, and the code for a value.
+	//
+	float Dequantize (uint32_t code) const
+	{
+		return static_cast<float>(code) * Step + Min;
+	}
+
+	uint32_t Quantize (float value) const
+	{
+		float scaled = (value - Min) * Scale;
+		scaled = scaled > 0.0f ? scaled : 0.0f;
+		scaled = scaled < MaxCode ? scaled : MaxCode;
+		return static_cast<uint32_t>(std::nearbyint(scaled));
+	}
+
+private:
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Count;
+		uint32_t Bits;
+		uint32_t Delta;
+		float Min;
+		float Max;
+	};
+
+	static const uint32_t Magic = 0x53515356;		// "VSQS"
+
+	// A block of codes as wide as a zigzagged 24-bit difference can get.
+	static const size_t MaxBlockBytes = (MaxBits + 1) * (BlockSize / 8);
+
+
+	static size_t GetBlockCount (size_t count)
+	{
+		return (count + BlockSize - 1) / BlockSize;
+	}
+
+	//
+	// Bytes taken by a block packed at the given width: width words in
+	// each of the eight streams.
+	//
+	static size_t GetPackedSize (unsigned width)
+	{
+		return width * (BlockSize / 8);
+	}
+
+	static size_t GetWidthTableSize (size_t blocks)
+	{
+		return (blocks + 3) & ~static_cast<size_t>(3);
+	}
+
+
+	//
+	// The common encoding pass. fetch(first, n, block) supplies the next
+	// n values, returning where they are: either already in place in the
+	// caller's array, or written to the given block buffer.
+	//
+	template <typename FetchFunction>
+	size_t EncodeBlocks (size_t count, const uint32_t * baseline, uint32_t * quantized, unsigned char * out, FetchFunction fetch) const
+	{
+		Header header = { Magic, static_cast<uint32_t>(count), Bits, baseline ? 1u : 0u, Min, Max };
+		std::memcpy(out, &header, sizeof(header));
+
+		const size_t blocks = GetBlockCount(count);
+		unsigned char * widths = out + sizeof(header);
+		std::memset(widths, 0, GetWidthTableSize(blocks));
+
+		unsigned char * packed = widths + GetWidthTableSize(blocks);
+
+		alignas(ValueSourceCacheLineSize) float block[BlockSize];
+		alignas(ValueSourceCacheLineSize) uint32_t codes[BlockSize];
+
+		for (size_t b = 0; b < blocks; ++b)
+		{
+			const size_t first = b * BlockSize;
+			const size_t n = count - first < BlockSize ? count - first : BlockSize;
+
+			const float * in = fetch(first, n, block);
+			if (n < BlockSize)
+			{
+				if (in != block)
+					std::memcpy(block, in, n * sizeof(float));
+
+				for (size_t i = n; i < BlockSize; ++i)
+					block[i] = Min;
+
+				in = block;
+			}
+
+			Quantize(in, codes);
+
+			if (quantized)
+				std::memcpy(quantized + first, codes, n * sizeof(uint32_t));
+
+			if (baseline)
+				TakeDelta(baseline + first, n, codes);
+
+			const unsigned width = GetWidth(codes);
+			widths[b] = static_cast<unsigned char>(width);
+
+			Pack(codes, width, packed);
+			packed += GetPackedSize(width);
+		}
+
+		return static_cast<size_t>(packed - out);
+	}
+
+
+	void Quantize (const float * values, uint32_t * codes) const
+	{
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		const __m256 min8 = _mm256_set1_ps(Min);
+		const __m256 scale8 = _mm256_set1_ps(Scale);
+		const __m256 zero8 = _mm256_setzero_ps();
+		const __m256 maxcode8 = _mm256_set1_ps(MaxCode);
+		for (; i < BlockSize; i += 8)
+		{
+			__m256 scaled = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(values + i), min8), scale8);
+			scaled = _mm256_min_ps(_mm256_max_ps(scaled, zero8), maxcode8);
+			_mm256_store_si256(reinterpret_cast<__m256i *>(codes + i), _mm256_cvtps_epi32(scaled));
+		}
+#elif defined(VALUESOURCE_SIMD_SSE)
+		const __m128 min4 = _mm_set1_ps(Min);
+		const __m128 scale4 = _mm_set1_ps(Scale);
+		const __m128 zero4 = _mm_setzero_ps();
+		const __m128 maxcode4 = _mm_set1_ps(MaxCode);
+		for (; i < BlockSize; i += 4)
+		{
+			__m128 scaled = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + i), min4), scale4);
+			scaled = _mm_min_ps(_mm_max_ps(scaled, zero4), maxcode4);
+			_mm_store_si128(reinterpret_cast<__m128i *>(codes + i), _mm_cvtps_epi32(scaled));
+		}
+#endif
+
+		for (; i < BlockSize; ++i)
+			codes[i] = Quantize(values[i]);
+	}
+
+
+	void Dequantize (const uint32_t * codes, size_t n, float * values) const
+	{
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		const __m256 min8 = _mm256_set1_ps(Min);
+		const __m256 step8 = _mm256_set1_ps(Step);
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256 code = _mm256_cvtepi32_ps(_mm256_load_si256(reinterpret_cast<const __m256i *>(codes + i)));
+			_mm256_storeu_ps(values + i, _mm256_add_ps(_mm256_mul_ps(code, step8), min8));
+		}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+		const __m128 min4 = _mm_set1_ps(Min);
+		const __m128 step4 = _mm_set1_ps(Step);
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128 code = _mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i *>(codes + i)));
+			_mm_storeu_ps(values + i, _mm_add_ps(_mm_mul_ps(code, step4), min4));
+		}
+#endif
+
+		for (; i < n; ++i)
+			values[i] = Dequantize(codes[i]);
+	}
+
+
+	//
+	// Replace the codes with zigzagged differences from the baseline. The
+	// padding past n stays zero, as it is zero in both.
+	//
+	static void TakeDelta (const uint32_t * baseline, size_t n, uint32_t * codes)
+	{
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i delta = _mm256_sub_epi32(_mm256_load_si256(reinterpret_cast<const __m256i *>(codes + i)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(baseline + i)));
+			_mm256_store_si256(reinterpret_cast<__m256i *>(codes + i), _mm256_xor_si256(_mm256_slli_epi32(delta, 1), _mm256_srai_epi32(delta, 31)));
+		}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i delta = _mm_sub_epi32(_mm_load_si128(reinterpret_cast<const __m128i *>(codes + i)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(baseline + i)));
+			_mm_store_si128(reinterpret_cast<__m128i *>(codes + i), _mm_xor_si128(_mm_slli_epi32(delta, 1), _mm_srai_epi32(delta, 31)));
+		}
+#endif
+
+		for (; i < n; ++i)
+		{
+			const uint32_t delta = codes[i] - baseline[i];
+			codes[i] = (delta << 1) ^ (0u - (delta >> 31));
+		}
+	}
+
+	static void ApplyDelta (const uint32_t * baseline, size_t n, uint32_t * codes)
+	{
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		const __m256i one8 = _mm256_set1_epi32(1);
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i zigzag = _mm256_load_si256(reinterpret_cast<const __m256i *>(codes + i));
+			__m256i delta = _mm256_xor_si256(_mm256_srli_epi32(zigzag, 1), _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(zigzag, one8)));
+			_mm256_store_si256(reinterpret_cast<__m256i *>(codes + i), _mm256_add_epi32(delta, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(baseline + i))));
+		}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+		const __m128i one4 = _mm_set1_epi32(1);
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i zigzag = _mm_load_si128(reinterpret_cast<const __m128i *>(codes + i));
+			__m128i delta = _mm_xor_si128(_mm_srli_epi32(zigzag, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(zigzag, one4)));
+			_mm_store_si128(reinterpret_cast<__m128i *>(codes + i), _mm_add_epi32(delta, _mm_loadu_si128(reinterpret_cast<const __m128i *>(baseline + i))));
+		}
+#endif
+
+		for (; i < n; ++i)
+			codes[i] = ((codes[i] >> 1) ^ (0u - (codes[i] & 1))) + baseline[i];
+	}
+
+
+	//
+	// Bits needed for the largest code in a block.
+	//
+	static unsigned GetWidth (const uint32_t * codes)
+	{
+		uint32_t all = 0;
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		__m256i all8 = _mm256_setzero_si256();
+		for (; i < BlockSize; i += 8)
+			all8 = _mm256_or_si256(all8, _mm256_load_si256(reinterpret_cast<const __m256i *>(codes + i)));
+
+		alignas(ValueSourceCacheLineSize) uint32_t lanes[8];
+		_mm256_store_si256(reinterpret_cast<__m256i *>(lanes), all8);
+		for (uint32_t lane : lanes)
+			all |= lane;
+#elif defined(VALUESOURCE_SIMD_SSE)
+		__m128i all4 = _mm_setzero_si128();
+		for (; i < BlockSize; i += 4)
+			all4 = _mm_or_si128(all4, _mm_load_si128(reinterpret_cast<const __m128i *>(codes + i)));
+
+		alignas(ValueSourceCacheLineSize) uint32_t lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i *>(lanes), all4);
+		for (uint32_t lane : lanes)
+			all |= lane;
+#endif
+
+		for (; i < BlockSize; ++i)
+			all |= codes[i];
+
+		unsigned width = 0;
+		while (width < 32 && (all >> width))
+			++width;
+
+		return width;
+	}
+
+
+	//
+	// Pack a block of codes, width bits each, into width * 8 words. Word j
+	// of stream l holds bits of the codes at l, l + 8, l + 16, ..., lowest
+	// first, and is stored at word j * 8 + l.
+	//
+	// Where each code lands depends only on the width and its position, so
+	// there is one fully unrolled routine per width, with every shift and
+	// word boundary fixed at compile time, picked from a table.
+	//
+	typedef void (*PackFunction) (const uint32_t * codes, unsigned char * out);
+	typedef void (*UnpackFunction) (const unsigned char * in, uint32_t * codes);
+
+
+	static void Pack (const uint32_t * codes, unsigned width, unsigned char * out)
+	{
+		GetPackTable(std::make_index_sequence<MaxBits + 2>())[width](codes, out);
+	}
+
+	static void Unpack (const unsigned char * in, unsigned width, uint32_t * codes)
+	{
+		GetUnpackTable(std::make_index_sequence<MaxBits + 2>())[width](in, codes);
+	}
+
+
+	template <size_t... Width>
+	static const PackFunction * GetPackTable (std::index_sequence<Width...>)
+	{
+		static const PackFunction table[] = { &PackBlock<static_cast<unsigned>(Width)>... };
+		return table;
+	}
+
+	template <size_t... Width>
+	static const UnpackFunction * GetUnpackTable (std::index_sequence<Width...>)
+	{
+		static const UnpackFunction table[] = { &UnpackBlock<static_cast<unsigned>(Width)>... };
+		return table;
+	}
+
+
+	template <unsigned Width>
+	static void PackBlock (const uint32_t * codes, unsigned char * out)
+	{
+		if (Width > 0)
+			PackGroups<Width>(codes, out, std::make_index_sequence<BlockSize / 8>());
+	}
+
+	template <unsigned Width>
+	static void UnpackBlock (const unsigned char * in, uint32_t * codes)
+	{
+		if (Width > 0)
+			UnpackGroups<Width>(in, codes, std::make_index_sequence<BlockSize / 8>());
+		else
+			std::memset(codes, 0, BlockSize * sizeof(uint32_t));
+	}
+
+
+	//
+	// The words of all eight streams being filled or drained.
+	//
+	struct StreamWords
+	{
+#if defined(VALUESOURCE_SIMD_AVX2)
+		__m256i Words;
+#elif defined(VALUESOURCE_SIMD_SSE)
+		__m128i Low;
+		__m128i High;
+#else
+		uint32_t Words[8];
+#endif
+	};
+
+
+	template <unsigned Width, size_t... Group>
+	static void PackGroups (const uint32_t * codes, unsigned char * out, std::index_sequence<Group...>)
+	{
+		StreamWords words = { };
+		(PackGroup<Width, Group>(codes, out, words), ...);
+	}
+
+	template <unsigned Width, size_t... Group>
+	static void UnpackGroups (const unsigned char * in, uint32_t * codes, std::index_sequence<Group...>)
+	{
+		StreamWords words = { };
+		(UnpackGroup<Width, Group>(in, codes, words), ...);
+	}
+
+
+	//
+	// Shift the group-th eight codes into the words being filled, storing
+	// them once full and starting the next with whatever spilled over.
+	//
+	template <unsigned Width, size_t Group>
+	static void PackGroup (const uint32_t * codes, unsigned char * out, StreamWords & words)
+	{
+		const unsigned Filled = (Group * Width) % 32;
+		const bool Full = Filled + Width >= 32;
+		const bool Spill = Filled + Width > 32;
+		const unsigned SpillShift = Spill ? 32 - Filled : 0;
+
+		const uint32_t * in = codes + Group * 8;
+		unsigned char * store = out + (Group * Width / 32) * 8 * sizeof(uint32_t);
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		__m256i code = _mm256_load_si256(reinterpret_cast<const __m256i *>(in));
+		words.Words = Filled ? _mm256_or_si256(words.Words, _mm256_slli_epi32(code, Filled)) : code;
+
+		if (Full)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(store), words.Words);
+			if (Spill)
+				words.Words = _mm256_srli_epi32(code, SpillShift);
+		}
+#elif defined(VALUESOURCE_SIMD_SSE)
+		__m128i low = _mm_load_si128(reinterpret_cast<const __m128i *>(in));
+		__m128i high = _mm_load_si128(reinterpret_cast<const __m128i *>(in + 4));
+		words.Low = Filled ? _mm_or_si128(words.Low, _mm_slli_epi32(low, Filled)) : low;
+		words.High = Filled ? _mm_or_si128(words.High, _mm_slli_epi32(high, Filled)) : high;
+
+		if (Full)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(store), words.Low);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(store + 4 * sizeof(uint32_t)), words.High);
+			if (Spill)
+			{
+				words.Low = _mm_srli_epi32(low, SpillShift);
+				words.High = _mm_srli_epi32(high, SpillShift);
+			}
+		}
+#else
+		for (size_t lane = 0; lane < 8; ++lane)
+			words.Words[lane] = Filled ? words.Words[lane] | (in[lane] << Filled) : in[lane];
+
+		if (Full)
+		{
+			std::memcpy(store, words.Words, sizeof(words.Words));
+			if (Spill)
+			{
+				for (size_t lane = 0; lane < 8; ++lane)
+					words.Words[lane] = in[lane] >> SpillShift;
+			}
+		}
+#endif
+	}
+
+
+	//
+	// Extract the group-th eight codes, loading the next words as the
+	// current ones run out.
+	//
+	template <unsigned Width, size_t Group>
+	static void UnpackGroup (const unsigned char * in, uint32_t * codes, StreamWords & words)
+	{
+		const unsigned Start = (Group * Width) % 32;
+		const bool Spill = Start + Width > 32;
+		const unsigned SpillShift = Spill ? 32 - Start : 0;
+		const uint32_t Mask = Width < 32 ? (1u << (Width % 32)) - 1 : 0xFFFFFFFFu;
+
+		const unsigned char * load = in + (Group * Width / 32) * 8 * sizeof(uint32_t);
+		uint32_t * out = codes + Group * 8;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		if (Start == 0)
+			words.Words = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(load));
+
+		__m256i code = _mm256_srli_epi32(words.Words, Start);
+		if (Spill)
+		{
+			words.Words = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(load + 8 * sizeof(uint32_t)));
+			code = _mm256_or_si256(code, _mm256_slli_epi32(words.Words, SpillShift));
+		}
+
+		_mm256_store_si256(reinterpret_cast<__m256i *>(out), _mm256_and_si256(code, _mm256_set1_epi32(static_cast<int>(Mask))));
+#elif defined(VALUESOURCE_SIMD_SSE)
+		if (Start == 0)
+		{
+			words.Low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(load));
+			words.High = _mm_loadu_si128(reinterpret_cast<const __m128i *>(load + 4 * sizeof(uint32_t)));
+		}
+
+		__m128i low = _mm_srli_epi32(words.Low, Start);
+		__m128i high = _mm_srli_epi32(words.High, Start);
+		if (Spill)
+		{
+			words.Low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(load + 8 * sizeof(uint32_t)));
+			words.High = _mm_loadu_si128(reinterpret_cast<const __m128i *>(load + 12 * sizeof(uint32_t)));
+			low = _mm_or_si128(low, _mm_slli_epi32(words.Low, SpillShift));
+			high = _mm_or_si128(high, _mm_slli_epi32(words.High, SpillShift));
+		}
+
+		const __m128i mask = _mm_set1_epi32(static_cast<int>(Mask));
+		_mm_store_si128(reinterpret_cast<__m128i *>(out), _mm_and_si128(low, mask));
+		_mm_store_si128(reinterpret_cast<__m128i *>(out + 4), _mm_and_si128(high, mask));
+#else
+		if (Start == 0)
+			std::memcpy(words.Words, load, sizeof(words.Words));
+
+		uint32_t code[8];
+		for (size_t lane = 0; lane < 8; ++lane)
+			code[lane] = words.Words[lane] >> Start;
+
+		if (Spill)
+		{
+			std::memcpy(words.Words, load + 8 * sizeof(uint32_t), sizeof(words.Words));
+			for (size_t lane = 0; lane < 8; ++lane)
+				code[lane] |= words.Words[lane] << SpillShift;
+		}
+
+		for (size_t lane = 0; lane < 8; ++lane)
+			out[lane] = code[lane] & Mask;
+#endif
+	}
+
+	float Min;
+	float Max;
+	unsigned Bits;
+	float MaxCode;
+	float Scale;
+	float Step;
+};
@@ -0,0 +1,317 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceClock.h"
+
+#include <cstring>
+#include <type_traits>
+
+
+//
+// The ValueSource interfaces pay for their flexibility with a virtual
+// call on every query and every Advance(). When the concrete type of a
+// source is known at compile time, that flexibility buys nothing. The
+// templates here express the same two interfaces through the curiously
+// recurring template pattern instead: no vtable, no indirection, and a
+// caller templated on the source type can inline the whole update.
+//
+// Static sources provide the same member functions as their virtual
+// counterparts (GetCurrentValue, and Advance for dynamic ones), so code
+// written against them looks exactly like code written for the others.
+// Templates taking a static source check for it with the
+// IsStaticValueSource trait below. The project builds as C++17, so a
+// detection trait and static_assert stand in for C++20 concepts.
+//
+template <typename Derived, typename T>
+class StaticValueSource
+{
+public:
+	typedef T ValueType;
+
+	const Derived & GetDerived () const
+	{
+		return static_cast<const Derived &>(*this);
+	}
+
+	Derived & GetDerived ()
+	{
+		return static_cast<Derived &>(*this);
+	}
+
+protected:
+	StaticValueSource () = default;
+	~StaticValueSource () = default;
+};
+
+
+template <typename Derived, typename T>
+class StaticDynamicValueSource : public StaticValueSource<Derived, T>
+{
+public:
+
+	//
+	// Stepping fallback, hidden by sources that have a closed form.
+	//
+	void FastForward (float dt, unsigned steps)
+	{
+		for (unsigned i = 0; i < steps; ++i)
+			this->GetDerived().Advance(dt);
+	}
+
+protected:
+	StaticDynamicValueSource () = default;
+	~StaticDynamicValueSource () = default;
+};
+
+
+//
+// Detects static sources, for constraining templates to them.
+//
+template <typename S>
+struct StaticValueSourceVoid
+{
+	typedef void type;
+};
+
+template <typename S, typename = void>
+struct IsStaticValueSource : std::false_type
+{ };
+
+template <typename S>
+struct IsStaticValueSource<S, typename StaticValueSourceVoid<typename S::ValueType>::type>
+	: std::is_base_of<StaticValueSource<S, typename S::ValueType>, S>
+{ };
+
+
+//
+// Compile-time equivalent of ValueSourceLinearAccumulator.
+//
+class StaticValueSourceLinearAccumulator : public StaticDynamicValueSource<StaticValueSourceLinearAccumulator, float>
+{
+public:
+	StaticValueSourceLinearAccumulator (float start, float velocity)
+		: Value(start),
+		  Velocity(velocity)
+	{ }
+
+
+	float GetCurrentValue () const
+	{
+		return Value;
+	}
+
+
+	void Advance (float dt)
+	{
+		Value += (Velocity * dt);
+	}
+
+
+	void FastForward (float dt, unsigned steps)
+	{
+		Value += Velocity * (dt * static_cast<float>(steps));
+	}
+
+private:
+	float Value;
+	float Velocity;
+};
+
+
+//
+// Compile-time equivalent of ValueSourceLinearInterpolator: setting the
+// time only records it, and the interpolator may instead follow a shared
+// ValueSourceClock. The value is worked out when read. Unlike the virtual
+// version it keeps no cache, since once inlined the lerp costs less than
+// checking one, which also leaves reads free of side effects.
+//
+class StaticValueSourceLinearInterpolator : public StaticValueSource<StaticValueSourceLinearInterpolator, float>
+{
+public:
+	StaticValueSourceLinearInterpolator (float min, float max, const ValueSourceClock * clock = nullptr)
+		: Min(min),
+		  Max(max),
+		  Time(0.0f),
+		  Clock(clock)
+	{ }
+
+
+	float GetCurrentValue () const
+	{
+		float t = Clock ? Clock->GetTime() : Time;
+
+		if (t < 0.0f)
+			t = 0.0f;
+
+		if (t > 1.0f)
+			t = 1.0f;
+
+		return Min + (Max - Min) * t;
+	}
+
+
+	//
+	// Explicitly setting the time detaches from any clock.
+	//
+	void SetTime (float t)
+	{
+		Time = t;
+		Clock = nullptr;
+	}
+
+	void AttachClock (const ValueSourceClock * clock)
+	{
+		Clock = clock;
+	}
+
+private:
+	float Min;
+	float Max;
+	float Time;
+	const ValueSourceClock * Clock;
+};
+
+
+//
+// Adapters between the two worlds.
+//
+// A static source can be wrapped up behind the virtual interfaces when
+// it needs to be attached to something that swaps sources at runtime,
+// and a virtual source can be dropped into code templated on a static
+// source type. In both cases the adapter costs exactly one indirection,
+// which is what the virtual design paid all along.
+//
+template <typename Source>
+class VirtualValueSourceAdapter : public ValueSource<typename Source::ValueType>
+{
+	static_assert(IsStaticValueSource<Source>::value, "VirtualValueSourceAdapter wraps static value sources");
+
+public:
+	typedef typename Source::ValueType ValueType;
+
+	explicit VirtualValueSourceAdapter (const Source & source)
+		: WrappedSource(source)
+	{ }
+
+
+	ValueType GetCurrentValue () const override
+	{
+		return WrappedSource.GetCurrentValue();
+	}
+
+
+	Source & GetSource ()
+	{
+		return WrappedSource;
+	}
+
+private:
+	Source WrappedSource;
+};
+
+
+template <typename Source>
+class VirtualDynamicValueSourceAdapter : public DynamicValueSource<typename Source::ValueType>
+{
+	static_assert(IsStaticValueSource<Source>::value, "VirtualDynamicValueSourceAdapter wraps static value sources");
+
+public:
+	typedef typename Source::ValueType ValueType;
+
+	explicit VirtualDynamicValueSourceAdapter (const Source & source)
+		: WrappedSource(source)
+	{ }
+
+
+	ValueType GetCurrentValue () const override
+	{
+		return WrappedSource.GetCurrentValue();
+	}
+
+
+	void Advance (float dt) override
+	{
+		WrappedSource.Advance(dt);
+	}
+
+
+	void FastForward (float dt, unsigned steps) override
+	{
+		WrappedSource.FastForward(dt, steps);
+	}
+
+
+	//
+	// Static sources are plain data, so the snapshot is the source.
+	//
+	size_t GetSnapshotSize () const override
+	{
+		return std::is_trivially_copyable<Source>::value ? sizeof(Source) : 0;
+	}
+
+	void SaveSnapshot (void * buffer) const override
+	{
+		if (std::is_trivially_copyable<Source>::value)
+			std::memcpy(buffer, &WrappedSource, sizeof(Source));
+	}
+
+	void RestoreSnapshot (const void * buffer) override
+	{
+		if (std::is_trivially_copyable<Source>::value)
+			std::memcpy(&WrappedSource, buffer, sizeof(Source));
+	}
+
+
+	Source & GetSource ()
+	{
+		return WrappedSource;
+	}
+
+private:
+	Source WrappedSource;
+};
+
+
+//
+// Going the other way: forward a static-looking source to whatever
+// virtual source is attached right now. This is how a statically typed
+// object keeps the ability to be handed over to another controller.
+//
+template <typename T>
+class StaticValueSourceFromVirtual : public StaticDynamicValueSource<StaticValueSourceFromVirtual<T>, T>
+{
+public:
+	explicit StaticValueSourceFromVirtual (DynamicValueSource<T> * source = nullptr)
+		: Source(source)
+	{ }
+
+
+	void Attach (DynamicValueSource<T> * source)
+	{
+		Source = source;
+	}
+
+
+	T GetCurrentValue () const
+	{
+		return Source ? Source->GetCurrentValue() : T();
+	}
+
+
+	void Advance (float dt)
+	{
+		if (Source)
+			Source->Advance(dt);
+	}
+
+
+	void FastForward (float dt, unsigned steps)
+	{
+		if (Source)
+			Source->FastForward(dt, steps);
+	}
+
+private:
+	DynamicValueSource<T> * Source;
+};
+
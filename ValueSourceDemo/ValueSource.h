@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 
 //
 // Instead of coding to an implementation of a float-typed value,
@@ -14,7 +16,20 @@ template <typename T>
 class ValueSource
 {
 public:
+	virtual ~ValueSource () { }
+
 	virtual T GetCurrentValue () const = 0;
+
+	//
+	// The rate at which the value is changing right now, per unit of
+	// time, for sources that know it exactly. Consumers like dead
+	// reckoning use it to predict where the value is heading. Sources
+	// that don't know return false and leave rate alone.
+	//
+	virtual bool GetCurrentRate (T &) const
+	{
+		return false;
+	}
 };
 
 
@@ -35,6 +50,48 @@ class DynamicValueSource : public ValueSource<T>
 {
 public:
 	virtual void Advance (float dt) = 0;
+
+	//
+	// Skip ahead by a number of identical steps in one go, e.g. for a
+	// late-joining client or to catch up after a stall. The fallback
+	// here simply steps, but sources with an analytic form override it
+	// with a closed-form jump, which costs O(1) and also avoids the
+	// drift that builds up when integrating tick by tick.
+	//
+	virtual void FastForward (float dt, unsigned steps)
+	{
+		for (unsigned i = 0; i < steps; ++i)
+			Advance(dt);
+	}
+
+	//
+	// Move the value to the given one while keeping whatever motion the
+	// source has, so that switching an object over to a new source can
+	// pick up from where the old one left off with no visible jump.
+	// Sources whose value is not theirs to set ignore this.
+	//
+	virtual void SetCurrentValue (const T &)
+	{
+	}
+
+	//
+	// Snapshots of internal state, for rewinding time. A source reports
+	// a fixed number of bytes of state and can copy exactly that much out
+	// to a buffer and back in again. Sources that derive their value from
+	// somewhere else entirely carry no state and keep these defaults.
+	//
+	virtual size_t GetSnapshotSize () const
+	{
+		return 0;
+	}
+
+	virtual void SaveSnapshot (void *) const
+	{
+	}
+
+	virtual void RestoreSnapshot (const void *)
+	{
+	}
 };
 
 
@@ -2,6 +2,8 @@
 
 #include "ValueSource.h"
 
+#include <cstring>
+
 
 class ValueSourceLinearAccumulator : public DynamicValueSource<float>
 {
@@ -18,11 +20,46 @@ public:
 	}
 
 
+	bool GetCurrentRate (float & rate) const override
+	{
+		rate = Velocity;
+		return true;
+	}
+
+
 	void Advance (float dt) override
 	{
 		Value += (Velocity * dt);
 	}
 
+
+	void FastForward (float dt, unsigned steps) override
+	{
+		Value += Velocity * (dt * static_cast<float>(steps));
+	}
+
+
+	void SetCurrentValue (const float & value) override
+	{
+		Value = value;
+	}
+
+
+	size_t GetSnapshotSize () const override
+	{
+		return sizeof(Value);
+	}
+
+	void SaveSnapshot (void * buffer) const override
+	{
+		std::memcpy(buffer, &Value, sizeof(Value));
+	}
+
+	void RestoreSnapshot (const void * buffer) override
+	{
+		std::memcpy(&Value, buffer, sizeof(Value));
+	}
+
 private:
 	float Value;
 	float Velocity;
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceSimd.h"
+
+#include <cstring>
+#include <vector>
+
+
+//
+// A whole population of linear accumulators, stored as a structure of
+// arrays. Rather than each object owning a ValueSourceLinearAccumulator
+// somewhere on the heap and paying an indirect call to Advance() it,
+// the batch keeps every value and velocity in contiguous aligned arrays
+// and steps them all in a single vectorized pass.
+//
+// Individual entries are still reachable through the usual interfaces
+// via lightweight views, so game objects don't need to know that their
+// position lives in a batch at all.
+//
+class ValueSourceLinearAccumulatorBatch
+{
+public:
+
+	//
+	// A view onto one entry of the batch. Note that Advance() does
+	// nothing here: the batch owns the stepping for every entry, so
+	// objects holding a view can keep calling Advance() as usual and
+	// the world advances the batch exactly once per tick.
+	//
+	// Views refer to the batch by index, so they stay valid as more
+	// entries are added and the underlying arrays grow.
+	//
+	class View : public DynamicValueSource<float>
+	{
+	public:
+		View (const ValueSourceLinearAccumulatorBatch & batch, size_t index)
+			: Batch(&batch),
+			  Index(index)
+		{ }
+
+
+		float GetCurrentValue () const override
+		{
+			return Batch->Values[Index];
+		}
+
+
+		void Advance (float) override
+		{
+		}
+
+	private:
+		const ValueSourceLinearAccumulatorBatch * Batch;
+		size_t Index;
+	};
+
+
+	void Reserve (size_t count)
+	{
+		Values.reserve(count);
+		Velocities.reserve(count);
+	}
+
+	size_t Add (float start, float velocity)
+	{
+		Values.push_back(start);
+		Velocities.push_back(velocity);
+		return Values.size() - 1;
+	}
+
+	size_t GetCount () const
+	{
+		return Values.size();
+	}
+
+	View GetView (size_t index) const
+	{
+		return View(*this, index);
+	}
+
+	float GetValue (size_t index) const
+	{
+		return Values[index];
+	}
+
+	float GetVelocity (size_t index) const
+	{
+		return Velocities[index];
+	}
+
+	//
+	// Write the values of entries [first, first + count) to out.
+	//
+	void GetCurrentValues (size_t first, size_t count, float * out) const
+	{
+		std::memcpy(out, Values.data() + first, count * sizeof(float));
+	}
+
+
+	//
+	// Step every entry forward by dt. This is the only place that
+	// touches the arrays during a tick, and it is purely a streaming
+	// read-modify-write, so at scale it runs at memory bandwidth.
+	//
+	void Advance (float dt)
+	{
+		const size_t count = Values.size();
+		float * values = Values.data();
+		const float * velocities = Velocities.data();
+
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		const __m256 dt8 = _mm256_set1_ps(dt);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 value = _mm256_load_ps(values + i);
+			__m256 velocity = _mm256_load_ps(velocities + i);
+			_mm256_store_ps(values + i, _mm256_add_ps(value, _mm256_mul_ps(velocity, dt8)));
+		}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+		const __m128 dt4 = _mm_set1_ps(dt);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 value = _mm_load_ps(values + i);
+			__m128 velocity = _mm_load_ps(velocities + i);
+			_mm_store_ps(values + i, _mm_add_ps(value, _mm_mul_ps(velocity, dt4)));
+		}
+#endif
+
+		for (; i < count; ++i)
+			values[i] += velocities[i] * dt;
+	}
+
+	//
+	// Snapshots cover every value in the batch in one block. Velocities
+	// are fixed once added, so they are not part of the state.
+	//
+	size_t GetSnapshotSize () const
+	{
+		return Values.size() * sizeof(float);
+	}
+
+	void SaveSnapshot (void * buffer) const
+	{
+		std::memcpy(buffer, Values.data(), Values.size() * sizeof(float));
+	}
+
+	void RestoreSnapshot (const void * buffer)
+	{
+		std::memcpy(Values.data(), buffer, Values.size() * sizeof(float));
+	}
+
+	//
+	// Closed-form jump over a run of identical steps.
+	//
+	void FastForward (float dt, unsigned steps)
+	{
+		Advance(dt * static_cast<float>(steps));
+	}
+
+private:
+	std::vector<float, AlignedAllocator<float>> Values;
+	std::vector<float, AlignedAllocator<float>> Velocities;
+};
+
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceBuckets.h"
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+
+//
+// A compact reference to a value source owned by a ValueSourceArena.
+//
+// The low 24 bits index the arena's handle table and the high 8 bits
+// hold the generation of that table entry when the handle was issued.
+// Destroying a source bumps its entry's generation, so any handle still
+// referring to it no longer matches and can be caught. A default handle
+// is null, since generations start from one.
+//
+struct ValueSourceHandle
+{
+	static const uint32_t IndexBits = 24;
+	static const uint32_t IndexMask = (1u << IndexBits) - 1;
+	static const uint32_t MaxIndex = IndexMask;
+
+	uint32_t Bits = 0;
+
+
+	uint32_t GetIndex () const
+	{
+		return Bits & IndexMask;
+	}
+
+	uint32_t GetGeneration () const
+	{
+		return Bits >> IndexBits;
+	}
+
+	bool IsNull () const
+	{
+		return Bits == 0;
+	}
+
+	static ValueSourceHandle Make (uint32_t index, uint32_t generation)
+	{
+		ValueSourceHandle handle;
+		handle.Bits = (generation << IndexBits) | index;
+		return handle;
+	}
+
+
+	bool operator == (const ValueSourceHandle & other) const
+	{
+		return Bits == other.Bits;
+	}
+
+	bool operator != (const ValueSourceHandle & other) const
+	{
+		return Bits != other.Bits;
+	}
+};
+
+
+//
+// Owns dynamic value sources and hands out 32-bit handles to them.
+//
+// The sources themselves live in type-segregated slabs (the arena is
+// built on DynamicValueSourceBuckets), so creating one never touches the
+// general heap once a slab has room, and advancing them all runs one
+// statically dispatched loop per type.
+//
+// Resolving a handle is a single indexed load from the handle table. In
+// debug builds it also checks the generation, which turns a stale handle
+// into an assertion rather than a read of whatever reused the slot.
+// IsAlive() performs the same check explicitly, in any build.
+//
+template <typename T>
+class ValueSourceArena
+{
+public:
+	ValueSourceArena () = default;
+	ValueSourceArena (const ValueSourceArena &) = delete;
+	ValueSourceArena & operator = (const ValueSourceArena &) = delete;
+
+
+	template <typename SourceT, typename... Args>
+	ValueSourceHandle Create (Args &&... args)
+	{
+		typename DynamicValueSourceBuckets<T>::Handle storage = Sources.template Emplace<SourceT>(std::forward<Args>(args)...);
+
+		uint32_t index;
+		if (!FreeIndices.empty())
+		{
+			index = FreeIndices.back();
+			FreeIndices.pop_back();
+		}
+		else
+		{
+			assert(Table.size() <= ValueSourceHandle::MaxIndex);
+			index = static_cast<uint32_t>(Table.size());
+			Table.push_back(Entry());
+			Storage.emplace_back();
+		}
+
+		Table[index].Source = Sources.Get(storage);
+		Storage[index] = storage;
+		return ValueSourceHandle::Make(index, Table[index].Generation);
+	}
+
+
+	//
+	// Destroys the source and invalidates every handle to it. Table
+	// entries are reused after 255 generations; a handle kept that long
+	// past destruction would go unnoticed, which is the price of fitting
+	// in 32 bits.
+	//
+	void Destroy (ValueSourceHandle handle)
+	{
+		assert(IsAlive(handle));
+
+		const uint32_t index = handle.GetIndex();
+		Sources.Remove(Storage[index]);
+
+		Entry & entry = Table[index];
+		entry.Source = nullptr;
+		entry.Generation = entry.Generation == MaxGeneration ? 1 : entry.Generation + 1;
+		FreeIndices.push_back(index);
+	}
+
+
+	bool IsAlive (ValueSourceHandle handle) const
+	{
+		const uint32_t index = handle.GetIndex();
+		return !handle.IsNull() && index < Table.size() && Table[index].Source && Table[index].Generation == handle.GetGeneration();
+	}
+
+	DynamicValueSource<T> & Get (ValueSourceHandle handle) const
+	{
+		assert(IsAlive(handle));
+		return *Table[handle.GetIndex()].Source;
+	}
+
+
+	size_t GetCount () const
+	{
+		return Sources.GetCount();
+	}
+
+
+	void Advance (float dt)
+	{
+		Sources.Advance(dt);
+	}
+
+	void FastForward (float dt, unsigned steps)
+	{
+		Sources.FastForward(dt, steps);
+	}
+
+	template <typename SourceT, typename Visitor>
+	void ForEachOfType (Visitor visitor)
+	{
+		Sources.template ForEachOfType<SourceT>(visitor);
+	}
+
+private:
+	static const uint32_t MaxGeneration = (1u << (32 - ValueSourceHandle::IndexBits)) - 1;
+
+	//
+	// The hot half of the table; where each source lives in the slabs is
+	// only needed to destroy it, so that is kept separately.
+	//
+	struct Entry
+	{
+		DynamicValueSource<T> * Source = nullptr;
+		uint32_t Generation = 1;
+	};
+
+	DynamicValueSourceBuckets<T> Sources;
+	std::vector<Entry> Table;
+	std::vector<typename DynamicValueSourceBuckets<T>::Handle> Storage;
+	std::vector<uint32_t> FreeIndices;
+};
+
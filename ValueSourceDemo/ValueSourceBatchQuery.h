@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceAccumulatorBatch.h"
+#include "ValueSourceLinearInterpolatorBatch.h"
+#include "ValueSourceSpline.h"
+#include "ValueSourceSpring.h"
+
+#include <cstddef>
+
+
+//
+// Read the current values of a whole range of sources into one caller
+// provided, contiguous buffer, so that consumers like rendering or the
+// network serializer can work through a flat array instead of chasing a
+// pointer and making a virtual call per object.
+//
+// The generic form works for any collection of sources and still pays
+// one virtual call per element, but keeps the consumer's loop tight. The
+// overloads for the built-in batch types skip the per-element calls and
+// stream straight out of their arrays.
+//
+// Buffers are passed as a pointer and a count. std::span would say the
+// same more safely, but it is C++20 and the project builds as C++17.
+//
+template <typename T>
+void GetCurrentValues (const ValueSource<T> * const * sources, size_t count, T * out)
+{
+	for (size_t i = 0; i < count; ++i)
+		out[i] = sources[i]->GetCurrentValue();
+}
+
+
+inline void GetCurrentValues (const ValueSourceLinearAccumulatorBatch & batch, size_t first, size_t count, float * out)
+{
+	batch.GetCurrentValues(first, count, out);
+}
+
+
+inline void GetCurrentValues (const ValueSourceLinearInterpolatorBatch & batch, size_t first, size_t count, float * out)
+{
+	batch.GetCurrentValues(first, count, out);
+}
+
+
+inline void GetCurrentValues (const ValueSourceSplineBatch & batch, size_t first, size_t count, float * out)
+{
+	batch.GetCurrentValues(first, count, out);
+}
+
+
+inline void GetCurrentValues (const ValueSourceSpringBatch & batch, size_t first, size_t count, float * out)
+{
+	batch.GetCurrentValues(first, count, out);
+}
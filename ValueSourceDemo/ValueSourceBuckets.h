@@ -0,0 +1,380 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceSimd.h"
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+//
+// A home for a heterogeneous population of dynamic value sources.
+//
+// Walking a list of DynamicValueSource pointers in creation order hops
+// from one vtable to another on nearly every element, which the branch
+// predictor hates. This container instead groups sources by concrete
+// type, keeping each type in its own contiguous storage, and advances
+// one group at a time with statically dispatched calls.
+//
+// Sources never move once created, so the pointer returned for a handle
+// can be attached directly to a MovingObject and stays valid until the
+// source is removed. Removed slots are recycled by later insertions of
+// the same type; every slot counts how often it has been removed, and
+// handles carry that generation, so a handle to a removed source is
+// caught rather than silently reaching whatever took its place.
+// Removing through such a handle does nothing.
+//
+template <typename T>
+class DynamicValueSourceBuckets
+{
+public:
+
+	struct Handle
+	{
+		DynamicValueSource<T> * Source;
+		uint32_t Bucket;
+		uint32_t Slot;
+		uint32_t Generation;
+	};
+
+
+	DynamicValueSourceBuckets () = default;
+	DynamicValueSourceBuckets (const DynamicValueSourceBuckets &) = delete;
+	DynamicValueSourceBuckets & operator = (const DynamicValueSourceBuckets &) = delete;
+
+
+	template <typename SourceT, typename... Args>
+	Handle Emplace (Args &&... args)
+	{
+		static_assert(std::is_base_of<DynamicValueSource<T>, SourceT>::value, "Buckets only hold dynamic value sources");
+
+		uint32_t bucketindex = GetBucketIndex<SourceT>();
+		Bucket<SourceT> * bucket = static_cast<Bucket<SourceT> *>(Buckets[bucketindex].get());
+
+		Handle handle;
+		handle.Bucket = bucketindex;
+		handle.Slot = bucket->Emplace(std::forward<Args>(args)...);
+		handle.Source = bucket->Get(handle.Slot);
+		handle.Generation = bucket->GetGeneration(handle.Slot);
+
+		++Count;
+		return handle;
+	}
+
+	//
+	// Returns false, leaving everything untouched, if the handle's source
+	// has already been removed.
+	//
+	bool Remove (const Handle & handle)
+	{
+		if (!IsAlive(handle))
+			return false;
+
+		Buckets[handle.Bucket]->Remove(handle.Slot);
+		--Count;
+		return true;
+	}
+
+
+	bool IsAlive (const Handle & handle) const
+	{
+		return handle.Bucket < Buckets.size() && Buckets[handle.Bucket]->IsCurrent(handle.Slot, handle.Generation);
+	}
+
+	DynamicValueSource<T> * Get (const Handle & handle) const
+	{
+		assert(IsAlive(handle));
+		return handle.Source;
+	}
+
+
+	size_t GetCount () const
+	{
+		return Count;
+	}
+
+
+	//
+	// One tight loop per concrete type.
+	//
+	void Advance (float dt)
+	{
+		for (auto & bucket : Buckets)
+			bucket->Advance(dt);
+	}
+
+	void FastForward (float dt, unsigned steps)
+	{
+		for (auto & bucket : Buckets)
+			bucket->FastForward(dt, steps);
+	}
+
+
+	//
+	// The same a bucket at a time and a range of slots at a time, for
+	// splitting the work across threads. Slots run from zero up to the
+	// bucket's slot count, and removed ones are skipped. Each bucket's
+	// storage starts on a cache line, so ranges split at multiples of 64
+	// slots never share a line.
+	//
+	size_t GetBucketCount () const
+	{
+		return Buckets.size();
+	}
+
+	size_t GetSlotCount (size_t bucket) const
+	{
+		return Buckets[bucket]->GetSlotCount();
+	}
+
+	void AdvanceRange (size_t bucket, float dt, size_t begin, size_t end)
+	{
+		Buckets[bucket]->AdvanceRange(dt, begin, end);
+	}
+
+
+	//
+	// Visit every live source, grouped by type. The typed overload is
+	// the one to use in hot code since it is statically dispatched.
+	//
+	void ForEach (const std::function<void (DynamicValueSource<T> &)> & visitor)
+	{
+		for (auto & bucket : Buckets)
+			bucket->Visit(visitor);
+	}
+
+	template <typename SourceT, typename Visitor>
+	void ForEachOfType (Visitor visitor)
+	{
+		auto iter = BucketIndices.find(std::type_index(typeid(SourceT)));
+		if (iter == BucketIndices.end())
+			return;
+
+		static_cast<Bucket<SourceT> *>(Buckets[iter->second].get())->VisitTyped(visitor);
+	}
+
+private:
+
+	class BucketBase
+	{
+	public:
+		virtual ~BucketBase () { }
+
+		virtual void Advance (float dt) = 0;
+		virtual void FastForward (float dt, unsigned steps) = 0;
+		virtual size_t GetSlotCount () const = 0;
+		virtual void AdvanceRange (float dt, size_t begin, size_t end) = 0;
+		virtual void Remove (uint32_t slot) = 0;
+		virtual bool IsCurrent (uint32_t slot, uint32_t generation) const = 0;
+		virtual void Visit (const std::function<void (DynamicValueSource<T> &)> & visitor) = 0;
+	};
+
+
+	//
+	// Storage for one concrete type, in fixed-size chunks so that the
+	// addresses of existing sources survive growth. Chunks start on a
+	// cache line, so splitting a bucket at multiples of 64 entries never
+	// puts two workers on the same line.
+	//
+	template <typename SourceT>
+	class Bucket : public BucketBase
+	{
+	public:
+		~Bucket () override
+		{
+			for (auto & chunk : Chunks)
+			{
+				for (uint32_t i = 0; i < chunk->Used; ++i)
+				{
+					if (chunk->Alive[i])
+						chunk->Get(i)->~SourceT();
+				}
+			}
+		}
+
+
+		template <typename... Args>
+		uint32_t Emplace (Args &&... args)
+		{
+			uint32_t slot;
+			if (!FreeSlots.empty())
+			{
+				slot = FreeSlots.back();
+				FreeSlots.pop_back();
+			}
+			else
+			{
+				if (Chunks.empty() || Chunks.back()->Used == ChunkSize)
+				{
+					Chunk * chunk = AlignedAllocator<Chunk>().allocate(1);
+					Chunks.emplace_back(new (chunk) Chunk);
+				}
+
+				Chunk & chunk = *Chunks.back();
+				slot = static_cast<uint32_t>((Chunks.size() - 1) * ChunkSize + chunk.Used);
+				chunk.Generation[chunk.Used] = 0;
+				++chunk.Used;
+			}
+
+			Chunk & chunk = *Chunks[slot / ChunkSize];
+			new (chunk.Get(slot % ChunkSize)) SourceT(std::forward<Args>(args)...);
+			chunk.Alive[slot % ChunkSize] = true;
+			return slot;
+		}
+
+		SourceT * Get (uint32_t slot)
+		{
+			return Chunks[slot / ChunkSize]->Get(slot % ChunkSize);
+		}
+
+		uint32_t GetGeneration (uint32_t slot) const
+		{
+			return Chunks[slot / ChunkSize]->Generation[slot % ChunkSize];
+		}
+
+		bool IsCurrent (uint32_t slot, uint32_t generation) const override
+		{
+			if (slot >= GetSlotCount())
+				return false;
+
+			const Chunk & chunk = *Chunks[slot / ChunkSize];
+			return chunk.Alive[slot % ChunkSize] && chunk.Generation[slot % ChunkSize] == generation;
+		}
+
+
+		void Remove (uint32_t slot) override
+		{
+			Chunk & chunk = *Chunks[slot / ChunkSize];
+			chunk.Get(slot % ChunkSize)->~SourceT();
+			chunk.Alive[slot % ChunkSize] = false;
+			++chunk.Generation[slot % ChunkSize];
+			FreeSlots.push_back(slot);
+		}
+
+
+		void Advance (float dt) override
+		{
+			for (auto & chunk : Chunks)
+			{
+				for (uint32_t i = 0; i < chunk->Used; ++i)
+				{
+					if (chunk->Alive[i])
+						chunk->Get(i)->SourceT::Advance(dt);
+				}
+			}
+		}
+
+		size_t GetSlotCount () const override
+		{
+			return Chunks.empty() ? 0 : (Chunks.size() - 1) * ChunkSize + Chunks.back()->Used;
+		}
+
+		void AdvanceRange (float dt, size_t begin, size_t end) override
+		{
+			for (size_t slot = begin; slot < end; )
+			{
+				Chunk & chunk = *Chunks[slot / ChunkSize];
+				const size_t base = slot - slot % ChunkSize;
+				const size_t last = end < base + chunk.Used ? end : base + chunk.Used;
+
+				for (; slot < last; ++slot)
+				{
+					if (chunk.Alive[slot - base])
+						chunk.Get(static_cast<uint32_t>(slot - base))->SourceT::Advance(dt);
+				}
+
+				slot = base + ChunkSize;
+			}
+		}
+
+		void FastForward (float dt, unsigned steps) override
+		{
+			for (auto & chunk : Chunks)
+			{
+				for (uint32_t i = 0; i < chunk->Used; ++i)
+				{
+					if (chunk->Alive[i])
+						chunk->Get(i)->SourceT::FastForward(dt, steps);
+				}
+			}
+		}
+
+
+		void Visit (const std::function<void (DynamicValueSource<T> &)> & visitor) override
+		{
+			VisitTyped(visitor);
+		}
+
+		template <typename Visitor>
+		void VisitTyped (Visitor & visitor)
+		{
+			for (auto & chunk : Chunks)
+			{
+				for (uint32_t i = 0; i < chunk->Used; ++i)
+				{
+					if (chunk->Alive[i])
+						visitor(*chunk->Get(i));
+				}
+			}
+		}
+
+	private:
+		static const uint32_t ChunkSize = 1024;
+
+		struct Chunk
+		{
+			typename std::aligned_storage<sizeof(SourceT), alignof(SourceT)>::type Storage[ChunkSize];
+			bool Alive[ChunkSize];
+			uint32_t Generation[ChunkSize];
+			uint32_t Used = 0;
+
+			SourceT * Get (uint32_t index)
+			{
+				return reinterpret_cast<SourceT *>(&Storage[index]);
+			}
+		};
+
+		struct ChunkDeleter
+		{
+			void operator () (Chunk * chunk) const
+			{
+				chunk->~Chunk();
+				AlignedAllocator<Chunk>().deallocate(chunk, 1);
+			}
+		};
+
+		std::vector<std::unique_ptr<Chunk, ChunkDeleter>> Chunks;
+		std::vector<uint32_t> FreeSlots;
+	};
+
+
+	template <typename SourceT>
+	uint32_t GetBucketIndex ()
+	{
+		std::type_index type(typeid(SourceT));
+
+		auto iter = BucketIndices.find(type);
+		if (iter != BucketIndices.end())
+			return iter->second;
+
+		uint32_t index = static_cast<uint32_t>(Buckets.size());
+		Buckets.emplace_back(new Bucket<SourceT>);
+		BucketIndices.emplace(type, index);
+		return index;
+	}
+
+
+	std::vector<std::unique_ptr<BucketBase>> Buckets;
+	std::unordered_map<std::type_index, uint32_t> BucketIndices;
+	size_t Count = 0;
+};
+
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+
+//
+// A single time value that any number of reactive value sources can
+// follow. Setting the time on the clock is all it takes to move every
+// source attached to it; nothing is recomputed until somebody actually
+// asks one of those sources for its value.
+//
+// The epoch changes every time the clock is set, which gives followers
+// a cheap way to tell whether anything they cached is still current.
+// Followers may be read from many threads at once, but the clock must
+// not be set while they are.
+//
+class ValueSourceClock
+{
+public:
+	explicit ValueSourceClock (float time = 0.0f)
+		: Time(time),
+		  Epoch(0)
+	{ }
+
+
+	void SetTime (float t)
+	{
+		Time = t;
+		++Epoch;
+	}
+
+	float GetTime () const
+	{
+		return Time;
+	}
+
+	uint32_t GetEpoch () const
+	{
+		return Epoch;
+	}
+
+private:
+	float Time;
+	uint32_t Epoch;
+};
@@ -0,0 +1,379 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceClock.h"
+#include "ValueSourceReplication.h"
+#include "ValueSourceSimd.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+
+//
+// Dead-reckoning replication.
+//
+// Rather than sending every object's value at a fixed rate, the sender
+// sends a value together with the rate it is changing at, and the
+// receiver extrapolates from there. The sender runs the same prediction
+// for every object, and only sends a fresh value and rate once the
+// prediction has drifted from the real value by more than a threshold.
+// Objects moving steadily then cost nothing to replicate, however long
+// they keep moving.
+//
+// Sources that can't report their rate are sent with a rate of zero,
+// which degrades to sending them whenever they have moved far enough.
+//
+// Over a transport that can lose packets, a lost update would leave the
+// receiver extrapolating stale motion for as long as the sender believes
+// its prediction holds, so every object is also resent after a maximum
+// interval regardless.
+//
+
+
+//
+// Wire format: a header as for plain replication, with its own magic,
+// followed by (object id, value, rate) triples.
+//
+struct DeadReckoningPacketEntry
+{
+	uint32_t Id;
+	float Value;
+	float Rate;
+};
+
+const uint32_t DeadReckoningPacketMagic = 0x52445356;	// "VSDR"
+
+
+//
+// The sending side. Object ids are positions in the arrays passed to
+// Update(), which must keep the same objects in the same places from one
+// call to the next.
+//
+// What the receiver is predicting is kept per object in flat arrays, so
+// each tick the error of every object is checked in one vectorized pass
+// over all of them; only the objects found over the threshold are then
+// touched individually.
+//
+class DeadReckoningReplicator
+{
+public:
+	DeadReckoningReplicator (size_t count, float threshold, float maxinterval = 1.0f, size_t maxentriesperpacket = 0)
+		: Threshold(threshold),
+		  MaxInterval(maxinterval),
+		  MaxEntries(maxentriesperpacket),
+		  SentValues(count, std::numeric_limits<float>::infinity()),
+		  SentRates(count, 0.0f),
+		  SentTimes(count, 0.0f),
+		  Values(count),
+		  Rates(count)
+	{
+		Dirty.reserve(count);
+	}
+
+
+	size_t GetCount () const
+	{
+		return SentValues.size();
+	}
+
+	//
+	// The receiver's predicted value for an object at the given time, as
+	// of the last update sent for it.
+	//
+	float GetPredictedValue (size_t id, float time) const
+	{
+		return SentValues[id] + SentRates[id] * (time - SentTimes[id]);
+	}
+
+
+	//
+	// Check every source against its prediction and send updates for
+	// those that need one. Returns the number of objects sent.
+	//
+	size_t Update (ReplicationTransport & transport, float time, const ValueSource<float> * const * sources)
+	{
+		const size_t count = GetCount();
+		for (size_t i = 0; i < count; ++i)
+			Values[i] = sources[i]->GetCurrentValue();
+
+		Scan(time, Values.data());
+
+		for (uint32_t id : Dirty)
+		{
+			if (!sources[id]->GetCurrentRate(Rates[id]))
+				Rates[id] = 0.0f;
+		}
+
+		return Emit(transport, time, Values.data(), Rates.data());
+	}
+
+	//
+	// The same for objects whose values and rates are already laid out in
+	// arrays, such as batches, with no calls per object at all. Without
+	// rates, every object is treated as being at rest.
+	//
+	size_t Update (ReplicationTransport & transport, float time, const float * values, const float * rates = nullptr)
+	{
+		Scan(time, values);
+
+		if (!rates)
+		{
+			for (uint32_t id : Dirty)
+				Rates[id] = 0.0f;
+
+			rates = Rates.data();
+		}
+
+		return Emit(transport, time, values, rates);
+	}
+
+private:
+	//
+	// Collect the ids of every object whose prediction is off by more
+	// than the threshold, or whose last update is too old, into Dirty.
+	// Objects that have never been sent are predicted at infinity, which
+	// is always over.
+	//
+	void Scan (float time, const float * values)
+	{
+		Dirty.clear();
+
+		const float * sentvalues = SentValues.data();
+		const float * sentrates = SentRates.data();
+		const float * senttimes = SentTimes.data();
+		const size_t count = GetCount();
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		const __m256 time8 = _mm256_set1_ps(time);
+		const __m256 threshold8 = _mm256_set1_ps(Threshold);
+		const __m256 interval8 = _mm256_set1_ps(MaxInterval);
+		const __m256 absmask8 = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 age = _mm256_sub_ps(time8, _mm256_load_ps(senttimes + i));
+			__m256 predicted = _mm256_add_ps(_mm256_load_ps(sentvalues + i), _mm256_mul_ps(_mm256_load_ps(sentrates + i), age));
+			__m256 error = _mm256_and_ps(_mm256_sub_ps(_mm256_loadu_ps(values + i), predicted), absmask8);
+			__m256 over = _mm256_or_ps(_mm256_cmp_ps(error, threshold8, _CMP_GT_OQ), _mm256_cmp_ps(age, interval8, _CMP_GE_OQ));
+
+			for (int mask = _mm256_movemask_ps(over), lane = 0; mask; mask >>= 1, ++lane)
+			{
+				if (mask & 1)
+					Dirty.push_back(static_cast<uint32_t>(i + lane));
+			}
+		}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+		const __m128 time4 = _mm_set1_ps(time);
+		const __m128 threshold4 = _mm_set1_ps(Threshold);
+		const __m128 interval4 = _mm_set1_ps(MaxInterval);
+		const __m128 absmask4 = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 age = _mm_sub_ps(time4, _mm_load_ps(senttimes + i));
+			__m128 predicted = _mm_add_ps(_mm_load_ps(sentvalues + i), _mm_mul_ps(_mm_load_ps(sentrates + i), age));
+			__m128 error = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(values + i), predicted), absmask4);
+			__m128 over = _mm_or_ps(_mm_cmpgt_ps(error, threshold4), _mm_cmpge_ps(age, interval4));
+
+			for (int mask = _mm_movemask_ps(over), lane = 0; mask; mask >>= 1, ++lane)
+			{
+				if (mask & 1)
+					Dirty.push_back(static_cast<uint32_t>(i + lane));
+			}
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			const float age = time - senttimes[i];
+			const float error = std::fabs(values[i] - (sentvalues[i] + sentrates[i] * age));
+			if (error > Threshold || age >= MaxInterval)
+				Dirty.push_back(static_cast<uint32_t>(i));
+		}
+	}
+
+
+	//
+	// Send the objects in Dirty, and remember what the receiver will now
+	// be predicting for them.
+	//
+	size_t Emit (ReplicationTransport & transport, float time, const float * values, const float * rates)
+	{
+		const size_t count = Dirty.size();
+		const size_t perpacket = MaxEntries ? MaxEntries : count;
+
+		for (size_t first = 0; first < count; first += perpacket)
+		{
+			size_t entries = count - first < perpacket ? count - first : perpacket;
+			Buffer.resize(sizeof(ReplicationPacketHeader) + entries * sizeof(DeadReckoningPacketEntry));
+
+			ReplicationPacketHeader header = { DeadReckoningPacketMagic, static_cast<uint32_t>(entries), time };
+			std::memcpy(Buffer.data(), &header, sizeof(header));
+
+			unsigned char * out = Buffer.data() + sizeof(header);
+			for (size_t i = first; i < first + entries; ++i)
+			{
+				const uint32_t id = Dirty[i];
+				DeadReckoningPacketEntry entry = { id, values[id], rates[id] };
+				std::memcpy(out, &entry, sizeof(entry));
+				out += sizeof(entry);
+
+				SentValues[id] = values[id];
+				SentRates[id] = rates[id];
+				SentTimes[id] = time;
+			}
+
+			transport.Send(Buffer.data(), Buffer.size());
+		}
+
+		return count;
+	}
+
+
+	float Threshold;
+	float MaxInterval;
+	size_t MaxEntries;
+
+	std::vector<float, AlignedAllocator<float>> SentValues;
+	std::vector<float, AlignedAllocator<float>> SentRates;
+	std::vector<float, AlignedAllocator<float>> SentTimes;
+
+	std::vector<float, AlignedAllocator<float>> Values;
+	std::vector<float> Rates;
+	std::vector<uint32_t> Dirty;
+	std::vector<unsigned char> Buffer;
+};
+
+
+//
+// The receiving end of one dead-reckoned object: the last value received,
+// carried forward at the last rate received. Times are the sender's, so
+// the clock should follow the sender's time.
+//
+class ValueSourceDeadReckoned : public ValueSource<float>
+{
+public:
+	explicit ValueSourceDeadReckoned (const ValueSourceClock & clock)
+		: Clock(&clock),
+		  Value(0.0f),
+		  Rate(0.0f),
+		  Time(0.0f)
+	{ }
+
+
+	//
+	// Updates older than the one already held are ignored, so reordered
+	// packets can't roll an object back.
+	//
+	void PushUpdate (float time, float value, float rate)
+	{
+		if (time < Time)
+			return;
+
+		Time = time;
+		Value = value;
+		Rate = rate;
+	}
+
+
+	float GetCurrentValue () const override
+	{
+		return Value + Rate * (Clock->GetTime() - Time);
+	}
+
+	bool GetCurrentRate (float & rate) const override
+	{
+		rate = Rate;
+		return true;
+	}
+
+private:
+	const ValueSourceClock * Clock;
+
+	float Value;
+	float Rate;
+	float Time;
+};
+
+
+//
+// Owns the dead-reckoned sources for one stream of objects and feeds them
+// from a transport, in the same way as the ReplicationReceiver.
+//
+class DeadReckoningReceiver
+{
+public:
+	DeadReckoningReceiver (size_t count, const ValueSourceClock & clock)
+	{
+		Sources.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+			Sources.emplace_back(clock);
+	}
+
+	DeadReckoningReceiver (const DeadReckoningReceiver &) = delete;
+	DeadReckoningReceiver & operator = (const DeadReckoningReceiver &) = delete;
+
+
+	size_t GetCount () const
+	{
+		return Sources.size();
+	}
+
+	ValueSourceDeadReckoned & GetSource (size_t id)
+	{
+		return Sources[id];
+	}
+
+
+	//
+	// Returns the number of packets applied. Malformed packets and
+	// entries for unknown ids are skipped.
+	//
+	size_t Pump (ReplicationTransport & transport)
+	{
+		size_t packets = 0;
+		while (transport.Receive(Packet))
+		{
+			if (Apply(Packet.data(), Packet.size()))
+				++packets;
+		}
+
+		return packets;
+	}
+
+	bool Apply (const unsigned char * data, size_t size)
+	{
+		ReplicationPacketHeader header;
+		if (size < sizeof(header))
+			return false;
+
+		std::memcpy(&header, data, sizeof(header));
+		if (header.Magic != DeadReckoningPacketMagic)
+			return false;
+
+		if ((size - sizeof(header)) / sizeof(DeadReckoningPacketEntry) < header.Count)
+			return false;
+
+		const unsigned char * in = data + sizeof(header);
+		const size_t sourcecount = Sources.size();
+		for (uint32_t i = 0; i < header.Count; ++i)
+		{
+			DeadReckoningPacketEntry entry;
+			std::memcpy(&entry, in, sizeof(entry));
+			in += sizeof(entry);
+
+			if (entry.Id < sourcecount)
+				Sources[entry.Id].PushUpdate(header.Time, entry.Value, entry.Rate);
+		}
+
+		return true;
+	}
+
+private:
+	std::vector<ValueSourceDeadReckoned> Sources;
+	std::vector<unsigned char> Packet;
+};
@@ -0,0 +1,316 @@
+#pragma once
+
+#include "StaticValueSource.h"
+
+#include <type_traits>
+
+
+//
+// Building value sources out of other value sources.
+//
+// A source like "offset plus a scaled oscillator, clamped to a range"
+// could be written as a chain of ValueSource objects, each one making a
+// virtual call into the next. Here, each combination is a small static
+// source holding its operands by value, so writing the expression out
+// produces a single nested type whose GetCurrentValue() the compiler can
+// flatten into one inlined evaluation:
+//
+//   auto height = Clamp(Constant(2.0f) + Scale(Ref(bobbing), 0.5f), 0.0f, 3.0f);
+//
+// Ref() pulls an existing source into an expression by pointer, so that
+// the expression sees it move. Referencing a virtual ValueSource costs a
+// call at that leaf only. To attach the finished expression to something
+// expecting a ValueSource, wrap it in a VirtualValueSourceAdapter.
+//
+
+
+template <typename T>
+class ValueSourceConstant : public StaticValueSource<ValueSourceConstant<T>, T>
+{
+public:
+	explicit ValueSourceConstant (const T & value)
+		: Value(value)
+	{ }
+
+	T GetCurrentValue () const
+	{
+		return Value;
+	}
+
+private:
+	T Value;
+};
+
+
+template <typename Source>
+class ValueSourceStaticRef : public StaticValueSource<ValueSourceStaticRef<Source>, typename Source::ValueType>
+{
+public:
+	explicit ValueSourceStaticRef (const Source & source)
+		: Referenced(&source)
+	{ }
+
+	typename Source::ValueType GetCurrentValue () const
+	{
+		return Referenced->GetCurrentValue();
+	}
+
+private:
+	const Source * Referenced;
+};
+
+
+template <typename T>
+class ValueSourceVirtualRef : public StaticValueSource<ValueSourceVirtualRef<T>, T>
+{
+public:
+	explicit ValueSourceVirtualRef (const ValueSource<T> & source)
+		: Referenced(&source)
+	{ }
+
+	T GetCurrentValue () const
+	{
+		return Referenced->GetCurrentValue();
+	}
+
+private:
+	const ValueSource<T> * Referenced;
+};
+
+
+template <typename A, typename B>
+class ValueSourceSum : public StaticValueSource<ValueSourceSum<A, B>, typename A::ValueType>
+{
+public:
+	ValueSourceSum (const A & a, const B & b)
+		: Left(a),
+		  Right(b)
+	{ }
+
+	typename A::ValueType GetCurrentValue () const
+	{
+		return Left.GetCurrentValue() + Right.GetCurrentValue();
+	}
+
+private:
+	A Left;
+	B Right;
+};
+
+
+template <typename A, typename B>
+class ValueSourceProduct : public StaticValueSource<ValueSourceProduct<A, B>, typename A::ValueType>
+{
+public:
+	ValueSourceProduct (const A & a, const B & b)
+		: Left(a),
+		  Right(b)
+	{ }
+
+	typename A::ValueType GetCurrentValue () const
+	{
+		return Left.GetCurrentValue() * Right.GetCurrentValue();
+	}
+
+private:
+	A Left;
+	B Right;
+};
+
+
+template <typename A>
+class ValueSourceScale : public StaticValueSource<ValueSourceScale<A>, typename A::ValueType>
+{
+public:
+	ValueSourceScale (const A & a, float factor)
+		: Operand(a),
+		  Factor(factor)
+	{ }
+
+	typename A::ValueType GetCurrentValue () const
+	{
+		return Operand.GetCurrentValue() * Factor;
+	}
+
+private:
+	A Operand;
+	float Factor;
+};
+
+
+template <typename A>
+class ValueSourceClamp : public StaticValueSource<ValueSourceClamp<A>, typename A::ValueType>
+{
+public:
+	typedef typename A::ValueType ValueType;
+
+	ValueSourceClamp (const A & a, const ValueType & low, const ValueType & high)
+		: Operand(a),
+		  Low(low),
+		  High(high)
+	{ }
+
+	ValueType GetCurrentValue () const
+	{
+		ValueType value = Operand.GetCurrentValue();
+
+		if (value < Low)
+			return Low;
+
+		if (value > High)
+			return High;
+
+		return value;
+	}
+
+private:
+	A Operand;
+	ValueType Low;
+	ValueType High;
+};
+
+
+//
+// Linearly maps [inmin, inmax] onto [outmin, outmax], without clamping.
+// The division is folded into a scale factor up front.
+//
+template <typename A>
+class ValueSourceRemap : public StaticValueSource<ValueSourceRemap<A>, typename A::ValueType>
+{
+public:
+	ValueSourceRemap (const A & a, float inmin, float inmax, float outmin, float outmax)
+		: Operand(a),
+		  InMin(inmin),
+		  OutMin(outmin),
+		  Factor((outmax - outmin) / (inmax - inmin))
+	{ }
+
+	typename A::ValueType GetCurrentValue () const
+	{
+		return OutMin + (Operand.GetCurrentValue() - InMin) * Factor;
+	}
+
+private:
+	A Operand;
+	float InMin;
+	float OutMin;
+	float Factor;
+};
+
+
+template <typename A, typename B>
+class ValueSourceMin : public StaticValueSource<ValueSourceMin<A, B>, typename A::ValueType>
+{
+public:
+	ValueSourceMin (const A & a, const B & b)
+		: Left(a),
+		  Right(b)
+	{ }
+
+	typename A::ValueType GetCurrentValue () const
+	{
+		typename A::ValueType left = Left.GetCurrentValue();
+		typename A::ValueType right = Right.GetCurrentValue();
+		return right < left ? right : left;
+	}
+
+private:
+	A Left;
+	B Right;
+};
+
+
+template <typename A, typename B>
+class ValueSourceMax : public StaticValueSource<ValueSourceMax<A, B>, typename A::ValueType>
+{
+public:
+	ValueSourceMax (const A & a, const B & b)
+		: Left(a),
+		  Right(b)
+	{ }
+
+	typename A::ValueType GetCurrentValue () const
+	{
+		typename A::ValueType left = Left.GetCurrentValue();
+		typename A::ValueType right = Right.GetCurrentValue();
+		return left < right ? right : left;
+	}
+
+private:
+	A Left;
+	B Right;
+};
+
+
+//
+// Builders. These only take part in overload resolution for static
+// sources, so they never hijack arithmetic on anything else.
+//
+template <typename A, typename B>
+struct ValueSourceBinaryEnable
+	: std::enable_if<IsStaticValueSource<A>::value && IsStaticValueSource<B>::value>
+{ };
+
+
+template <typename T>
+ValueSourceConstant<T> Constant (const T & value)
+{
+	return ValueSourceConstant<T>(value);
+}
+
+template <typename Source>
+typename std::enable_if<IsStaticValueSource<Source>::value, ValueSourceStaticRef<Source>>::type
+Ref (const Source & source)
+{
+	return ValueSourceStaticRef<Source>(source);
+}
+
+template <typename T>
+ValueSourceVirtualRef<T> Ref (const ValueSource<T> & source)
+{
+	return ValueSourceVirtualRef<T>(source);
+}
+
+
+template <typename A, typename B, typename = typename ValueSourceBinaryEnable<A, B>::type>
+ValueSourceSum<A, B> operator + (const A & a, const B & b)
+{
+	return ValueSourceSum<A, B>(a, b);
+}
+
+template <typename A, typename B, typename = typename ValueSourceBinaryEnable<A, B>::type>
+ValueSourceProduct<A, B> operator * (const A & a, const B & b)
+{
+	return ValueSourceProduct<A, B>(a, b);
+}
+
+template <typename A, typename = typename std::enable_if<IsStaticValueSource<A>::value>::type>
+ValueSourceScale<A> Scale (const A & a, float factor)
+{
+	return ValueSourceScale<A>(a, factor);
+}
+
+template <typename A, typename = typename std::enable_if<IsStaticValueSource<A>::value>::type>
+ValueSourceClamp<A> Clamp (const A & a, const typename A::ValueType & low, const typename A::ValueType & high)
+{
+	return ValueSourceClamp<A>(a, low, high);
+}
+
+template <typename A, typename = typename std::enable_if<IsStaticValueSource<A>::value>::type>
+ValueSourceRemap<A> Remap (const A & a, float inmin, float inmax, float outmin, float outmax)
+{
+	return ValueSourceRemap<A>(a, inmin, inmax, outmin, outmax);
+}
+
+template <typename A, typename B, typename = typename ValueSourceBinaryEnable<A, B>::type>
+ValueSourceMin<A, B> MinOf (const A & a, const B & b)
+{
+	return ValueSourceMin<A, B>(a, b);
+}
+
+template <typename A, typename B, typename = typename ValueSourceBinaryEnable<A, B>::type>
+ValueSourceMax<A, B> MaxOf (const A & a, const B & b)
+{
+	return ValueSourceMax<A, B>(a, b);
+}
+
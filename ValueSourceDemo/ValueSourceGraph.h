@@ -0,0 +1,312 @@
+#pragma once
+
+#include "ValueSource.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+
+//
+// A graph of derived values that only recomputes what has changed.
+//
+// The pull-based reactive sources recompute on every read, so a value
+// derived from other derived values re-derives its whole subtree each
+// time. Here every node instead declares its inputs up front and caches
+// its value. A change is pushed downstream immediately, but only as far
+// as marking nodes dirty; reading a node then recomputes just the dirty
+// nodes it depends on, each once, inputs before outputs. Work therefore
+// scales with how much of the graph a change actually reaches.
+//
+// Nodes can only take inputs from nodes that already exist, so the order
+// nodes are added in is always a valid evaluation order, and cycles
+// cannot be built.
+//
+// Reads may recompute and so update the graph; concurrent reads need
+// external synchronization, as with the lazy interpolators.
+//
+class ValueSourceGraph
+{
+public:
+	typedef uint32_t Node;
+
+	//
+	// Derived nodes compute their value from their inputs' values, given
+	// in the order the inputs were declared.
+	//
+	typedef std::function<float (const float * inputs)> Function;
+
+
+	//
+	// A node exposed as an ordinary value source.
+	//
+	class NodeView : public ValueSource<float>
+	{
+	public:
+		NodeView (const ValueSourceGraph & graph, Node node)
+			: Graph(&graph),
+			  Index(node)
+		{ }
+
+
+		float GetCurrentValue () const override
+		{
+			return Graph->GetValue(Index);
+		}
+
+	private:
+		const ValueSourceGraph * Graph;
+		Node Index;
+	};
+
+
+	ValueSourceGraph ()
+		: Evaluations(0)
+	{ }
+
+	ValueSourceGraph (const ValueSourceGraph &) = delete;
+	ValueSourceGraph & operator = (const ValueSourceGraph &) = delete;
+
+
+	//
+	// A value set from outside with SetInput().
+	//
+	Node AddInput (float value)
+	{
+		Node node = AddNode(Kind::Input, nullptr, Function(), nullptr, 0);
+		Values[node] = value;
+		return node;
+	}
+
+	//
+	// A value read from any other value source. The graph can't tell when
+	// such a source changes, so whoever changes it calls Invalidate().
+	//
+	Node AddSource (const ValueSource<float> * source)
+	{
+		return AddNode(Kind::Source, source, Function(), nullptr, 0);
+	}
+
+	Node AddDerived (Function function, const Node * inputs, size_t count)
+	{
+		return AddNode(Kind::Derived, nullptr, std::move(function), inputs, count);
+	}
+
+	Node AddDerived (Function function, std::initializer_list<Node> inputs)
+	{
+		return AddDerived(std::move(function), inputs.begin(), inputs.size());
+	}
+
+
+	size_t GetNodeCount () const
+	{
+		return Kinds.size();
+	}
+
+	NodeView GetView (Node node) const
+	{
+		return NodeView(*this, node);
+	}
+
+
+	//
+	// Setting an input to the value it already has changes nothing.
+	//
+	void SetInput (Node node, float value)
+	{
+		if (Values[node] == value)
+			return;
+
+		Values[node] = value;
+		MarkDownstreamDirty(node);
+	}
+
+	//
+	// Mark a node as changed, e.g. a source node whose source moved.
+	//
+	void Invalidate (Node node)
+	{
+		if (Kinds[node] != Kind::Input)
+			Dirty[node] = true;
+
+		MarkDownstreamDirty(node);
+	}
+
+
+	float GetValue (Node node) const
+	{
+		if (Dirty[node])
+			Refresh(node);
+
+		return Values[node];
+	}
+
+	//
+	// Bring every dirty node up to date in one forward pass, for callers
+	// that will read most of the graph anyway.
+	//
+	void Update () const
+	{
+		for (Node node = 0; node < Kinds.size(); ++node)
+		{
+			if (Dirty[node])
+				Evaluate(node);
+		}
+	}
+
+
+	//
+	// Total node recomputations so far, for profiling.
+	//
+	uint64_t GetEvaluationCount () const
+	{
+		return Evaluations;
+	}
+
+private:
+	enum class Kind : uint8_t
+	{
+		Input,
+		Source,
+		Derived
+	};
+
+
+	Node AddNode (Kind kind, const ValueSource<float> * source, Function function, const Node * inputs, size_t count)
+	{
+		const Node node = static_cast<Node>(Kinds.size());
+
+		for (size_t i = 0; i < count; ++i)
+			assert(inputs[i] < node);
+
+		Kinds.push_back(kind);
+		Sources.push_back(source);
+		Functions.push_back(std::move(function));
+		Values.push_back(0.0f);
+		Dirty.push_back(kind != Kind::Input);
+		Visited.push_back(false);
+		Dependents.emplace_back();
+
+		InputStart.push_back(static_cast<uint32_t>(Inputs.size()));
+		for (size_t i = 0; i < count; ++i)
+		{
+			Inputs.push_back(inputs[i]);
+			Dependents[inputs[i]].push_back(node);
+		}
+
+		return node;
+	}
+
+
+	//
+	// A dirty node's dependents are always dirty already, so the walk
+	// can stop at any node that is. That keeps repeated changes before
+	// a read from walking the same region over and over.
+	//
+	void MarkDownstreamDirty (Node node)
+	{
+		Stack.clear();
+		for (Node dependent : Dependents[node])
+			Stack.push_back(dependent);
+
+		while (!Stack.empty())
+		{
+			Node current = Stack.back();
+			Stack.pop_back();
+
+			if (Dirty[current])
+				continue;
+
+			Dirty[current] = true;
+			for (Node dependent : Dependents[current])
+				Stack.push_back(dependent);
+		}
+	}
+
+
+	//
+	// Find every dirty node the given one depends on, then evaluate them
+	// in index order, which puts every input before its users.
+	//
+	void Refresh (Node node) const
+	{
+		Stack.clear();
+		Pending.clear();
+		Stack.push_back(node);
+		Visited[node] = true;
+
+		while (!Stack.empty())
+		{
+			Node current = Stack.back();
+			Stack.pop_back();
+			Pending.push_back(current);
+
+			for (uint32_t i = InputStart[current]; i < GetInputEnd(current); ++i)
+			{
+				Node input = Inputs[i];
+				if (Dirty[input] && !Visited[input])
+				{
+					Visited[input] = true;
+					Stack.push_back(input);
+				}
+			}
+		}
+
+		std::sort(Pending.begin(), Pending.end());
+		for (Node pending : Pending)
+		{
+			Visited[pending] = false;
+			Evaluate(pending);
+		}
+	}
+
+
+	void Evaluate (Node node) const
+	{
+		if (Kinds[node] == Kind::Source)
+		{
+			Values[node] = Sources[node]->GetCurrentValue();
+		}
+		else if (Kinds[node] == Kind::Derived)
+		{
+			Scratch.clear();
+			for (uint32_t i = InputStart[node]; i < GetInputEnd(node); ++i)
+				Scratch.push_back(Values[Inputs[i]]);
+
+			Values[node] = Functions[node](Scratch.data());
+		}
+
+		Dirty[node] = false;
+		++Evaluations;
+	}
+
+	uint32_t GetInputEnd (Node node) const
+	{
+		return node + 1 < InputStart.size() ? InputStart[node + 1] : static_cast<uint32_t>(Inputs.size());
+	}
+
+
+	std::vector<Kind> Kinds;
+	std::vector<const ValueSource<float> *> Sources;
+	std::vector<Function> Functions;
+
+	// Inputs of node n are Inputs[InputStart[n]] up to the next node's
+	// start; dependents are the reverse edges, for pushing changes.
+	std::vector<uint32_t> InputStart;
+	std::vector<Node> Inputs;
+	std::vector<std::vector<Node>> Dependents;
+
+	mutable std::vector<float> Values;
+	mutable std::vector<bool> Dirty;
+	mutable std::vector<bool> Visited;
+	mutable uint64_t Evaluations;
+
+	mutable std::vector<Node> Stack;
+	mutable std::vector<Node> Pending;
+	mutable std::vector<float> Scratch;
+};
+
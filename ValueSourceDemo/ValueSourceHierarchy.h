@@ -0,0 +1,288 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceSimd.h"
+#include "WorkStealingThreadPool.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+//
+// Values attached to other values, such as a turret riding on a vehicle:
+// each node's world value is its parent's world value plus its own local
+// value.
+//
+// Asking a child's source for its value by recursively asking its parent
+// costs a chain of virtual calls as deep as the hierarchy, for every
+// node, every time. Here the links are instead kept in flat arrays with
+// nodes sorted by depth, roots first. Every parent then comes before all
+// of its children, and one forward pass computes every world value from
+// values that are already final:
+//
+//     World[i] = World[Parent[i]] + Local[i]
+//
+// That is a gather and an add per node, with no calls and no recursion.
+// Nodes at the same depth never depend on one another, so each depth
+// level can also be split across a thread pool.
+//
+// Node ids are handed out in the order nodes are added and never change;
+// the depth ordering is internal, and is rebuilt on the next pass after
+// nodes are added.
+//
+class ValueSourceHierarchy
+{
+public:
+	typedef uint32_t Node;
+
+	static const Node NoParent = 0xFFFFFFFFu;
+
+
+	//
+	// A node's world value, as an ordinary value source. Values are those
+	// of the last Propagate(), and zero for nodes added since.
+	//
+	class View : public ValueSource<float>
+	{
+	public:
+		View (const ValueSourceHierarchy & hierarchy, Node node)
+			: Hierarchy(&hierarchy),
+			  Index(node)
+		{ }
+
+
+		float GetCurrentValue () const override
+		{
+			return Hierarchy->GetWorldValue(Index);
+		}
+
+	private:
+		const ValueSourceHierarchy * Hierarchy;
+		Node Index;
+	};
+
+
+	ValueSourceHierarchy ()
+		: OrderValid(true)
+	{ }
+
+	ValueSourceHierarchy (const ValueSourceHierarchy &) = delete;
+	ValueSourceHierarchy & operator = (const ValueSourceHierarchy &) = delete;
+
+
+	//
+	// Parents must be added before their children, which also rules out
+	// cycles. A node's local value is either read from a source by
+	// GatherLocals(), or, without one, set directly with SetLocal().
+	//
+	Node Add (Node parent, const ValueSource<float> * local = nullptr)
+	{
+		assert(parent == NoParent || parent < GetCount());
+
+		if (OrderValid)
+		{
+			for (size_t position = 0; position < Order.size(); ++position)
+			{
+				NodeLocals[Order[position]] = Local[position];
+				NodeWorlds[Order[position]] = World[position];
+			}
+
+			OrderValid = false;
+		}
+
+		const Node node = static_cast<Node>(NodeParents.size());
+
+		NodeParents.push_back(parent);
+		NodeDepths.push_back(parent == NoParent ? 0 : NodeDepths[parent] + 1);
+		NodeSources.push_back(local);
+		NodeLocals.push_back(0.0f);
+		NodeWorlds.push_back(0.0f);
+
+		return node;
+	}
+
+	size_t GetCount () const
+	{
+		return NodeParents.size();
+	}
+
+	View GetView (Node node) const
+	{
+		return View(*this, node);
+	}
+
+
+	void SetLocal (Node node, float value)
+	{
+		if (OrderValid)
+			Local[Position[node]] = value;
+		else
+			NodeLocals[node] = value;
+	}
+
+	float GetWorldValue (Node node) const
+	{
+		return OrderValid ? World[Position[node]] : NodeWorlds[node];
+	}
+
+	size_t GetLevelCount () const
+	{
+		return LevelStart.empty() ? 0 : LevelStart.size() - 1;
+	}
+
+
+	//
+	// Read every node's local source into its local value. This is the
+	// part that still makes one virtual call per node, so it is kept out
+	// of the propagation pass proper; it can be split across the pool
+	// too, since nodes are independent here.
+	//
+	void GatherLocals (WorkStealingThreadPool * pool = nullptr, size_t grain = DefaultGrain)
+	{
+		Build();
+
+		const ValueSource<float> * const * sources = Sources.data();
+		float * local = Local.data();
+
+		auto gather = [sources, local] (size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				if (sources[i])
+					local[i] = sources[i]->GetCurrentValue();
+			}
+		};
+
+		if (pool)
+			pool->ParallelFor(Sources.size(), grain, gather);
+		else
+			gather(0, Sources.size());
+	}
+
+
+	//
+	// Compute every world value, one depth level after another. With a
+	// pool, each level is split into chunks of grain nodes; levels too
+	// small to split just run on the calling thread.
+	//
+	void Propagate (WorkStealingThreadPool * pool = nullptr, size_t grain = DefaultGrain)
+	{
+		Build();
+
+		if (LevelStart.size() < 2)
+			return;
+
+		const float * local = Local.data();
+		float * world = World.data();
+		std::memcpy(world, local, LevelStart[1] * sizeof(float));
+
+		const int32_t * parents = Parent.data();
+		for (size_t level = 1; level + 1 < LevelStart.size(); ++level)
+		{
+			const size_t first = LevelStart[level];
+			const size_t count = LevelStart[level + 1] - first;
+
+			auto propagate = [parents, local, world, first] (size_t begin, size_t end)
+			{
+				PropagateRange(parents, local, world, first + begin, first + end);
+			};
+
+			if (pool)
+				pool->ParallelFor(count, grain, propagate);
+			else
+				propagate(0, count);
+		}
+	}
+
+private:
+	static const size_t DefaultGrain = 16 * 1024;
+
+
+	static void PropagateRange (const int32_t * parents, const float * local, float * world, size_t begin, size_t end)
+	{
+		size_t i = begin;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256i parent = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(parents + i));
+			__m256 base = _mm256_i32gather_ps(world, parent, sizeof(float));
+			_mm256_storeu_ps(world + i, _mm256_add_ps(base, _mm256_loadu_ps(local + i)));
+		}
+#endif
+
+		for (; i < end; ++i)
+			world[i] = world[parents[i]] + local[i];
+	}
+
+
+	//
+	// Counting sort of the nodes by depth, stable in id order, then lay
+	// out the per-position arrays to match.
+	//
+	void Build ()
+	{
+		if (OrderValid)
+			return;
+
+		const size_t count = NodeParents.size();
+
+		uint32_t maxdepth = 0;
+		for (uint32_t depth : NodeDepths)
+			maxdepth = depth > maxdepth ? depth : maxdepth;
+
+		LevelStart.assign(count ? maxdepth + 2 : 0, 0);
+		for (uint32_t depth : NodeDepths)
+			++LevelStart[depth + 1];
+		for (size_t level = 1; level < LevelStart.size(); ++level)
+			LevelStart[level] += LevelStart[level - 1];
+
+		std::vector<size_t> next(LevelStart.begin(), LevelStart.end());
+		Order.resize(count);
+		Position.resize(count);
+		for (Node node = 0; node < count; ++node)
+		{
+			size_t position = next[NodeDepths[node]]++;
+			Order[position] = node;
+			Position[node] = static_cast<uint32_t>(position);
+		}
+
+		Parent.resize(count);
+		Sources.resize(count);
+		Local.resize(count);
+		World.resize(count);
+		for (size_t position = 0; position < count; ++position)
+		{
+			const Node node = Order[position];
+			Parent[position] = NodeParents[node] == NoParent ? 0 : static_cast<int32_t>(Position[NodeParents[node]]);
+			Sources[position] = NodeSources[node];
+			Local[position] = NodeLocals[node];
+			World[position] = NodeWorlds[node];
+		}
+
+		OrderValid = true;
+	}
+
+
+	// By node id, as added. Values live here only while nodes are being
+	// added, between one build and the next.
+	std::vector<Node> NodeParents;
+	std::vector<uint32_t> NodeDepths;
+	std::vector<const ValueSource<float> *> NodeSources;
+	std::vector<float> NodeLocals;
+	std::vector<float> NodeWorlds;
+
+	// By position in depth order.
+	std::vector<Node> Order;
+	std::vector<uint32_t> Position;
+	std::vector<size_t> LevelStart;
+	std::vector<int32_t, AlignedAllocator<int32_t>> Parent;
+	std::vector<const ValueSource<float> *> Sources;
+	std::vector<float, AlignedAllocator<float>> Local;
+	std::vector<float, AlignedAllocator<float>> World;
+
+	bool OrderValid;
+};
+
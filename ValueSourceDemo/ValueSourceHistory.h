@@ -0,0 +1,217 @@
+#pragma once
+
+#include "ValueSource.h"
+
+#include <cstdint>
+#include <vector>
+
+
+//
+// Rewinding time for the update/present style of value sources.
+//
+// Reactive sources get rewinding for free, since their value is a pure
+// function of time. Dynamic sources accumulate state as they advance,
+// so to go back we have to have remembered that state. This keeps the
+// last N ticks worth of snapshots for a set of tracked sources in one
+// ring buffer that is allocated up front; recording and restoring only
+// copy bytes in and out of it, with no allocation per tick.
+//
+// Anything exposing GetSnapshotSize/SaveSnapshot/RestoreSnapshot can be
+// tracked, which covers every DynamicValueSource as well as the batch
+// stores. If a tracked object's snapshot size changes, e.g. a batch that
+// gains sources, the ring buffer is laid out afresh at the next Record()
+// and the history recorded so far is discarded, since its frames no
+// longer fit.
+//
+class ValueSourceHistory
+{
+public:
+	explicit ValueSourceHistory (unsigned capacity)
+		: Capacity(capacity ? capacity : 1),
+		  FrameSize(0),
+		  NewestTick(0),
+		  Count(0)
+	{ }
+
+
+	//
+	// Add something to the set of tracked state. Tracking reshapes the
+	// ring buffer, so it should happen up front; any history recorded
+	// before the call is discarded.
+	//
+	template <typename Tracked>
+	void Track (Tracked & tracked)
+	{
+		Entry entry;
+		entry.Object = &tracked;
+		entry.Offset = 0;
+		entry.Size = 0;
+		entry.GetSize = &GetEntrySize<Tracked>;
+		entry.Save = &SaveEntry<Tracked>;
+		entry.Restore = &RestoreEntry<Tracked>;
+
+		Entries.push_back(entry);
+		Layout();
+	}
+
+
+	//
+	// Snapshot every tracked source as the state of the given tick.
+	// Ticks are expected to be recorded consecutively; recording out of
+	// sequence starts a fresh history at that tick.
+	//
+	void Record (uint64_t tick)
+	{
+		if (Count > 0 && tick != NewestTick + 1)
+			Count = 0;
+
+		if (HasLayoutChanged())
+			Layout();
+
+		unsigned char * frame = GetFrame(tick);
+		for (const Entry & entry : Entries)
+			entry.Save(entry.Object, frame + entry.Offset);
+
+		NewestTick = tick;
+		if (Count < Capacity)
+			++Count;
+	}
+
+
+	bool HasTick (uint64_t tick) const
+	{
+		return Count > 0 && tick <= NewestTick && NewestTick - tick < Count;
+	}
+
+	uint64_t GetNewestTick () const
+	{
+		return NewestTick;
+	}
+
+	uint64_t GetOldestTick () const
+	{
+		return NewestTick - (Count ? Count - 1 : 0);
+	}
+
+
+	//
+	// Put every tracked source back into the state it had at the given
+	// tick. Later ticks are dropped, since replaying will record them
+	// anew. Returns false if the tick has already fallen out of history,
+	// or the history was discarded because a snapshot size changed.
+	//
+	bool RewindTo (uint64_t tick)
+	{
+		if (HasLayoutChanged())
+			Layout();
+
+		if (!HasTick(tick))
+			return false;
+
+		const unsigned char * frame = GetFrame(tick);
+		for (const Entry & entry : Entries)
+			entry.Restore(entry.Object, frame + entry.Offset);
+
+		Count -= static_cast<unsigned>(NewestTick - tick);
+		NewestTick = tick;
+		return true;
+	}
+
+
+	//
+	// Simulate forward again from the newest recorded tick up to and
+	// including the target, recording as we go. The step function gets
+	// the tick being produced, which is the place to apply corrected
+	// inputs before advancing the sources.
+	//
+	template <typename StepFunction>
+	void Replay (uint64_t targettick, StepFunction step)
+	{
+		for (uint64_t tick = NewestTick + 1; tick <= targettick; ++tick)
+		{
+			step(tick);
+			Record(tick);
+		}
+	}
+
+private:
+	struct Entry
+	{
+		void * Object;
+		size_t Offset;
+		size_t Size;
+		size_t (*GetSize) (const void * object);
+		void (*Save) (const void * object, void * buffer);
+		void (*Restore) (void * object, const void * buffer);
+	};
+
+
+	template <typename Tracked>
+	static size_t GetEntrySize (const void * object)
+	{
+		return static_cast<const Tracked *>(object)->GetSnapshotSize();
+	}
+
+	template <typename Tracked>
+	static void SaveEntry (const void * object, void * buffer)
+	{
+		static_cast<const Tracked *>(object)->SaveSnapshot(buffer);
+	}
+
+	template <typename Tracked>
+	static void RestoreEntry (void * object, const void * buffer)
+	{
+		static_cast<Tracked *>(object)->RestoreSnapshot(buffer);
+	}
+
+
+	bool HasLayoutChanged () const
+	{
+		for (const Entry & entry : Entries)
+		{
+			if (entry.GetSize(entry.Object) != entry.Size)
+				return true;
+		}
+
+		return false;
+	}
+
+	//
+	// Place every entry at its current size and reallocate the ring to
+	// match, dropping any recorded history.
+	//
+	void Layout ()
+	{
+		FrameSize = 0;
+		for (Entry & entry : Entries)
+		{
+			entry.Offset = FrameSize;
+			entry.Size = entry.GetSize(entry.Object);
+			FrameSize += entry.Size;
+		}
+
+		Storage.assign(FrameSize * Capacity, 0);
+		Count = 0;
+	}
+
+
+	unsigned char * GetFrame (uint64_t tick)
+	{
+		return Storage.data() + static_cast<size_t>(tick % Capacity) * FrameSize;
+	}
+
+	const unsigned char * GetFrame (uint64_t tick) const
+	{
+		return Storage.data() + static_cast<size_t>(tick % Capacity) * FrameSize;
+	}
+
+
+	unsigned Capacity;
+	size_t FrameSize;
+	std::vector<Entry> Entries;
+	std::vector<unsigned char> Storage;
+
+	uint64_t NewestTick;
+	unsigned Count;
+};
+
@@ -1,39 +1,145 @@
 #pragma once
 
 #include "ValueSource.h"
+#include "ValueSourceClock.h"
 
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 
+
+//
+// Interpolates between two values as time runs from zero to one.
+//
+// Evaluation is lazy: setting the time only records it, and the value is
+// computed on the first query afterwards and then cached. Interpolators
+// that are written every tick but rarely read (say, because the object
+// they drive is off screen) therefore cost next to nothing.
+//
+// Instead of being given a time individually, an interpolator may also
+// follow a shared ValueSourceClock, in which case it picks up the clock's
+// time whenever it is read and the clock's epoch invalidates its cache.
+//
+// Reads may fill the cache, but stay safe to make from any number of
+// threads at once: the value and the epoch it belongs to are published
+// together as one atomic word, so a reader sees either a whole entry or
+// none, and readers racing to fill it all store the same thing. Setting
+// the time, or the clock's time, while others read still needs
+// synchronizing like any other write.
+//
 class ValueSourceLinearInterpolator : public ValueSource<float>
 {
 public:
-	ValueSourceLinearInterpolator (float min, float max) :
+	ValueSourceLinearInterpolator (float min, float max, const ValueSourceClock * clock = nullptr) :
 		Min(min),
 		Max(max),
-		Value(min),
-		Time(0.0f)
+		Time(0.0f),
+		Clock(clock),
+		Cache(0)
+	{ }
+
+	ValueSourceLinearInterpolator (const ValueSourceLinearInterpolator & other) :
+		Min(other.Min),
+		Max(other.Max),
+		Time(other.Time),
+		Clock(other.Clock),
+		Cache(other.Cache.load(std::memory_order_relaxed))
 	{ }
 
+	ValueSourceLinearInterpolator & operator = (const ValueSourceLinearInterpolator & other)
+	{
+		Min = other.Min;
+		Max = other.Max;
+		Time = other.Time;
+		Clock = other.Clock;
+		Cache.store(other.Cache.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		return *this;
+	}
+
+
 	float GetCurrentValue () const override
 	{
-		return Value;
+		const uint32_t stamp = GetStamp();
+		const uint64_t cache = Cache.load(std::memory_order_relaxed);
+		if (stamp && static_cast<uint32_t>(cache >> 32) == stamp)
+			return Unpack(cache);
+
+		const float value = Evaluate(Clock ? Clock->GetTime() : Time);
+		Cache.store(Pack(stamp, value), std::memory_order_relaxed);
+		return value;
+	}
+
+	//
+	// Time runs from zero to one, so the rate is the whole range while
+	// the interpolation is under way, and zero once it is clamped at
+	// either end.
+	//
+	bool GetCurrentRate (float & rate) const override
+	{
+		const float t = Clock ? Clock->GetTime() : Time;
+		rate = (t >= 0.0f && t < 1.0f) ? Max - Min : 0.0f;
+		return true;
 	}
 
+	//
+	// Explicitly setting the time detaches from any clock.
+	//
 	void SetTime (float t)
 	{
 		Time = t;
+		Clock = nullptr;
+		Cache.store(0, std::memory_order_relaxed);
+	}
+
+	void AttachClock (const ValueSourceClock * clock)
+	{
+		Clock = clock;
+		Cache.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	//
+	// The cache holds the value in its low half and a stamp in its high
+	// half. Stamp zero never matches, so storing zero empties the cache;
+	// with a clock the stamp is the clock's epoch plus one (zero, and so
+	// uncached, for the one epoch that wraps), otherwise it is one, and
+	// switching between the two always empties the cache first.
+	//
+	uint32_t GetStamp () const
+	{
+		return Clock ? Clock->GetEpoch() + 1 : 1;
+	}
+
+	static uint64_t Pack (uint32_t stamp, float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return static_cast<uint64_t>(stamp) << 32 | bits;
+	}
 
-		if (Time < 0.0f)
-			Time = 0.0f;
+	static float Unpack (uint64_t cache)
+	{
+		const uint32_t bits = static_cast<uint32_t>(cache);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
 
-		if (Time > 1.0f)
-			Time = 1.0f;
+	float Evaluate (float t) const
+	{
+		if (t < 0.0f)
+			t = 0.0f;
 
-		Value = Min + (Max - Min) * Time;
+		if (t > 1.0f)
+			t = 1.0f;
+
+		return Min + (Max - Min) * t;
 	}
 
-private:
 	float Min;
 	float Max;
-	float Value;
 	float Time;
-};
\ No newline at end of file
+	const ValueSourceClock * Clock;
+
+	mutable std::atomic<uint64_t> Cache;
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceClock.h"
+#include "ValueSourceSimd.h"
+
+#include <vector>
+
+
+//
+// Many linear interpolators sharing one notion of time, stored as a
+// structure of arrays. This is the common reactive setup where a whole
+// population follows a single ValueSourceClock; since the time is shared
+// and the interpolation is lazy anyway, there's nothing per-entry to do
+// until values are read, and reading a range of them is one vectorized
+// multiply-add over the arrays.
+//
+class ValueSourceLinearInterpolatorBatch
+{
+public:
+
+	//
+	// A view onto one entry, for attaching to reactive game objects.
+	//
+	class View : public ValueSource<float>
+	{
+	public:
+		View (const ValueSourceLinearInterpolatorBatch & batch, size_t index)
+			: Batch(&batch),
+			  Index(index)
+		{ }
+
+
+		float GetCurrentValue () const override
+		{
+			return Batch->GetValue(Index);
+		}
+
+	private:
+		const ValueSourceLinearInterpolatorBatch * Batch;
+		size_t Index;
+	};
+
+
+	explicit ValueSourceLinearInterpolatorBatch (const ValueSourceClock & clock)
+		: Clock(&clock)
+	{ }
+
+
+	void Reserve (size_t count)
+	{
+		Mins.reserve(count);
+		Ranges.reserve(count);
+	}
+
+	size_t Add (float min, float max)
+	{
+		Mins.push_back(min);
+		Ranges.push_back(max - min);
+		return Mins.size() - 1;
+	}
+
+	size_t GetCount () const
+	{
+		return Mins.size();
+	}
+
+	View GetView (size_t index) const
+	{
+		return View(*this, index);
+	}
+
+	float GetValue (size_t index) const
+	{
+		return Mins[index] + Ranges[index] * GetClampedTime();
+	}
+
+
+	//
+	// Write the values of entries [first, first + count) to out.
+	//
+	void GetCurrentValues (size_t first, size_t count, float * out) const
+	{
+		const float t = GetClampedTime();
+		const float * mins = Mins.data() + first;
+		const float * ranges = Ranges.data() + first;
+
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		const __m256 t8 = _mm256_set1_ps(t);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 min = _mm256_loadu_ps(mins + i);
+			__m256 range = _mm256_loadu_ps(ranges + i);
+			_mm256_storeu_ps(out + i, _mm256_add_ps(min, _mm256_mul_ps(range, t8)));
+		}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+		const __m128 t4 = _mm_set1_ps(t);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 min = _mm_loadu_ps(mins + i);
+			__m128 range = _mm_loadu_ps(ranges + i);
+			_mm_storeu_ps(out + i, _mm_add_ps(min, _mm_mul_ps(range, t4)));
+		}
+#endif
+
+		for (; i < count; ++i)
+			out[i] = mins[i] + ranges[i] * t;
+	}
+
+private:
+	float GetClampedTime () const
+	{
+		float t = Clock->GetTime();
+
+		if (t < 0.0f)
+			t = 0.0f;
+
+		if (t > 1.0f)
+			t = 1.0f;
+
+		return t;
+	}
+
+	const ValueSourceClock * Clock;
+
+	std::vector<float, AlignedAllocator<float>> Mins;
+	std::vector<float, AlignedAllocator<float>> Ranges;
+};
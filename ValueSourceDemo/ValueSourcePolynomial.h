@@ -0,0 +1,113 @@
+#pragma once
+
+#include "ValueSource.h"
+
+#include <array>
+#include <cstring>
+
+
+//
+// A value that follows a fixed polynomial in elapsed time, e.g. a body
+// under constant acceleration (degree two). Because the whole trajectory
+// is known analytically, advancing only moves the clock and re-evaluates
+// the polynomial, and fast-forwarding is a single jump regardless of how
+// many steps are being skipped.
+//
+// Elapsed time is kept in double precision so that long-running sources
+// do not lose resolution as the clock grows.
+//
+template <unsigned Degree>
+class ValueSourcePolynomial : public DynamicValueSource<float>
+{
+public:
+	typedef std::array<float, Degree + 1> Coefficients;
+
+	//
+	// Coefficients are given lowest order first, so { start, velocity,
+	// acceleration / 2 } describes simple ballistic motion.
+	//
+	explicit ValueSourcePolynomial (const Coefficients & coefficients)
+		: Terms(coefficients),
+		  Elapsed(0.0),
+		  Value(coefficients[0])
+	{ }
+
+
+	float GetCurrentValue () const override
+	{
+		return Value;
+	}
+
+
+	bool GetCurrentRate (float & rate) const override
+	{
+		double result = Degree * static_cast<double>(Terms[Degree]);
+		for (unsigned i = Degree; i > 1; --i)
+			result = result * Elapsed + (i - 1) * static_cast<double>(Terms[i - 1]);
+
+		rate = static_cast<float>(result);
+		return true;
+	}
+
+
+	void Advance (float dt) override
+	{
+		Elapsed += dt;
+		Evaluate();
+	}
+
+
+	void FastForward (float dt, unsigned steps) override
+	{
+		Elapsed += static_cast<double>(dt) * steps;
+		Evaluate();
+	}
+
+
+	//
+	// Shifts the whole curve by moving the constant term, so the shape
+	// of the motion from here on is unchanged.
+	//
+	void SetCurrentValue (const float & value) override
+	{
+		Terms[0] += value - Value;
+		Evaluate();
+	}
+
+
+	//
+	// Only the constant term can change after construction, so it and
+	// the elapsed time make up the whole state.
+	//
+	size_t GetSnapshotSize () const override
+	{
+		return sizeof(Elapsed) + sizeof(float);
+	}
+
+	void SaveSnapshot (void * buffer) const override
+	{
+		std::memcpy(buffer, &Elapsed, sizeof(Elapsed));
+		std::memcpy(static_cast<char *>(buffer) + sizeof(Elapsed), &Terms[0], sizeof(float));
+	}
+
+	void RestoreSnapshot (const void * buffer) override
+	{
+		std::memcpy(&Elapsed, buffer, sizeof(Elapsed));
+		std::memcpy(&Terms[0], static_cast<const char *>(buffer) + sizeof(Elapsed), sizeof(float));
+		Evaluate();
+	}
+
+private:
+	void Evaluate ()
+	{
+		double result = Terms[Degree];
+		for (unsigned i = Degree; i > 0; --i)
+			result = result * Elapsed + Terms[i - 1];
+
+		Value = static_cast<float>(result);
+	}
+
+	Coefficients Terms;
+	double Elapsed;
+	float Value;
+};
@@ -0,0 +1,548 @@
+#pragma once
+
+#include "ValueSource.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+//
+// Recorded value streams, played back straight from disk.
+//
+// A track file holds any number of tracks, each a run of timestamped
+// samples. The layout is meant to be used in place: a header, a table
+// of track descriptors, then for each track its sample times followed by
+// its sample values, every array starting on a cache line. Mapping the
+// file is then all the loading there is; the times can be binary
+// searched and the values read directly out of the page cache, and
+// nothing is parsed or copied to the heap no matter how long the
+// session was.
+//
+// All numbers are stored little-endian, which is to say as they are in
+// memory on every platform this runs on.
+//
+struct RecordedTrackFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t TrackCount;
+	uint32_t Reserved;
+};
+
+struct RecordedTrackDescriptor
+{
+	uint64_t TimesOffset;
+	uint64_t ValuesOffset;
+	uint64_t SampleCount;
+};
+
+const uint32_t RecordedTrackFileMagic = 0x54525356;		// "VSRT"
+const uint32_t RecordedTrackFileVersion = 1;
+
+
+//
+// Builds a track file. Tracks are gathered in memory and written out in
+// one go; this is the offline side of recording, so it favours
+// simplicity over footprint.
+//
+class RecordedTrackWriter
+{
+public:
+
+	//
+	// Tracks can be added whole, or started empty and built up sample by
+	// sample. Either way, sample times must be non-decreasing.
+	//
+	size_t AddTrack ()
+	{
+		Tracks.emplace_back();
+		return Tracks.size() - 1;
+	}
+
+	size_t AddTrack (const float * times, const float * values, size_t count)
+	{
+		Tracks.emplace_back();
+		Tracks.back().Times.assign(times, times + count);
+		Tracks.back().Values.assign(values, values + count);
+		return Tracks.size() - 1;
+	}
+
+	void AddSample (size_t track, float time, float value)
+	{
+		Tracks[track].Times.push_back(time);
+		Tracks[track].Values.push_back(value);
+	}
+
+	bool Save (const char * path) const
+	{
+		FILE * file = std::fopen(path, "wb");
+		if (!file)
+			return false;
+
+		std::vector<RecordedTrackDescriptor> descriptors(Tracks.size());
+		uint64_t offset = Align(sizeof(RecordedTrackFileHeader) + descriptors.size() * sizeof(RecordedTrackDescriptor));
+		for (size_t i = 0; i < Tracks.size(); ++i)
+		{
+			const uint64_t bytes = Tracks[i].Times.size() * sizeof(float);
+			descriptors[i].SampleCount = Tracks[i].Times.size();
+			descriptors[i].TimesOffset = offset;
+			descriptors[i].ValuesOffset = Align(offset + bytes);
+			offset = Align(descriptors[i].ValuesOffset + bytes);
+		}
+
+		RecordedTrackFileHeader header = { RecordedTrackFileMagic, RecordedTrackFileVersion, static_cast<uint32_t>(Tracks.size()), 0 };
+		uint64_t position = 0;
+		bool ok = Write(file, position, &header, sizeof(header));
+		ok = ok && Write(file, position, descriptors.data(), descriptors.size() * sizeof(RecordedTrackDescriptor));
+
+		for (size_t i = 0; ok && i < Tracks.size(); ++i)
+		{
+			ok = Pad(file, position, descriptors[i].TimesOffset)
+				&& Write(file, position, Tracks[i].Times.data(), Tracks[i].Times.size() * sizeof(float))
+				&& Pad(file, position, descriptors[i].ValuesOffset)
+				&& Write(file, position, Tracks[i].Values.data(), Tracks[i].Values.size() * sizeof(float));
+		}
+
+		ok = ok && Pad(file, position, offset);
+		return std::fclose(file) == 0 && ok;
+	}
+
+private:
+	struct Track
+	{
+		std::vector<float> Times;
+		std::vector<float> Values;
+	};
+
+
+	static uint64_t Align (uint64_t offset)
+	{
+		return (offset + 63) & ~static_cast<uint64_t>(63);
+	}
+
+	static bool Write (FILE * file, uint64_t & position, const void * data, size_t size)
+	{
+		position += size;
+		return size == 0 || std::fwrite(data, 1, size, file) == size;
+	}
+
+	static bool Pad (FILE * file, uint64_t & position, uint64_t target)
+	{
+		static const char zeros[64] = { };
+		return Write(file, position, zeros, static_cast<size_t>(target - position));
+	}
+
+	std::vector<Track> Tracks;
+};
+
+
+//
+// A view of one track inside a mapped file.
+//
+struct RecordedTrack
+{
+	const float * Times;
+	const float * Values;
+	size_t SampleCount;
+};
+
+
+//
+// A read-only mapping of a track file.
+//
+class RecordedTrackFile
+{
+public:
+	RecordedTrackFile ()
+		: Data(nullptr),
+		  Size(0)
+#if defined(_WIN32)
+		, File(INVALID_HANDLE_VALUE),
+		  Mapping(nullptr)
+#endif
+	{ }
+
+	explicit RecordedTrackFile (const char * path)
+		: RecordedTrackFile()
+	{
+		Open(path);
+	}
+
+	~RecordedTrackFile ()
+	{
+		Close();
+	}
+
+	RecordedTrackFile (const RecordedTrackFile &) = delete;
+	RecordedTrackFile & operator = (const RecordedTrackFile &) = delete;
+
+
+	//
+	// Maps the file and checks that its header and track table describe
+	// data that actually lies within it. Returns false, leaving the file
+	// closed, if it cannot be mapped or is not a valid track file.
+	//
+	bool Open (const char * path)
+	{
+		Close();
+
+#if defined(_WIN32)
+		File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (File == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(File, &size) || size.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+
+		Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (Mapping)
+			Data = static_cast<const unsigned char *>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+		Size = static_cast<size_t>(size.QuadPart);
+#else
+		int descriptor = ::open(path, O_RDONLY);
+		if (descriptor < 0)
+			return false;
+
+		struct stat status;
+		if (::fstat(descriptor, &status) == 0 && status.st_size > 0)
+		{
+			void * mapped = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, descriptor, 0);
+			if (mapped != MAP_FAILED)
+			{
+				Data = static_cast<const unsigned char *>(mapped);
+				Size = static_cast<size_t>(status.st_size);
+			}
+		}
+
+		// The mapping keeps the file alive by itself.
+		::close(descriptor);
+#endif
+
+		if (!Data || !Validate())
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+
+	void Close ()
+	{
+#if defined(_WIN32)
+		if (Data)
+			UnmapViewOfFile(Data);
+		if (Mapping)
+			CloseHandle(Mapping);
+		if (File != INVALID_HANDLE_VALUE)
+			CloseHandle(File);
+		Mapping = nullptr;
+		File = INVALID_HANDLE_VALUE;
+#else
+		if (Data)
+			::munmap(const_cast<unsigned char *>(Data), Size);
+#endif
+		Data = nullptr;
+		Size = 0;
+	}
+
+
+	bool IsOpen () const
+	{
+		return Data != nullptr;
+	}
+
+	size_t GetTrackCount () const
+	{
+		return Data ? Header().TrackCount : 0;
+	}
+
+	//
+	// Returns false, leaving the track empty, if the file isn't open or
+	// has no track at that index.
+	//
+	bool GetTrack (size_t index, RecordedTrack & track) const
+	{
+		track.Times = nullptr;
+		track.Values = nullptr;
+		track.SampleCount = 0;
+
+		if (index >= GetTrackCount())
+			return false;
+
+		RecordedTrackDescriptor descriptor;
+		std::memcpy(&descriptor, Data + sizeof(RecordedTrackFileHeader) + index * sizeof(RecordedTrackDescriptor), sizeof(descriptor));
+
+		track.Times = reinterpret_cast<const float *>(Data + descriptor.TimesOffset);
+		track.Values = reinterpret_cast<const float *>(Data + descriptor.ValuesOffset);
+		track.SampleCount = static_cast<size_t>(descriptor.SampleCount);
+		return true;
+	}
+
+
+	//
+	// Paging hints. Sequential tells the OS the whole file will be read
+	// front to back, so it reads ahead aggressively and drops pages once
+	// they're behind us. WillNeed starts reading a range in the
+	// background before playback gets to it.
+	//
+	void AdviseSequential () const
+	{
+#if !defined(_WIN32)
+		::madvise(const_cast<unsigned char *>(Data), Size, MADV_SEQUENTIAL);
+#endif
+	}
+
+	void WillNeed (const void * begin, size_t bytes) const
+	{
+		const unsigned char * first = static_cast<const unsigned char *>(begin);
+		const unsigned char * last = first + bytes;
+		if (first < Data || last > Data + Size || first >= last)
+			return;
+
+#if defined(_WIN32)
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+		WIN32_MEMORY_RANGE_ENTRY range = { const_cast<unsigned char *>(first), bytes };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+		const uintptr_t page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+		uintptr_t start = reinterpret_cast<uintptr_t>(first) & ~(page - 1);
+		::madvise(reinterpret_cast<void *>(start), reinterpret_cast<uintptr_t>(last) - start, MADV_WILLNEED);
+#endif
+	}
+
+private:
+	const RecordedTrackFileHeader & Header () const
+	{
+		return *reinterpret_cast<const RecordedTrackFileHeader *>(Data);
+	}
+
+	bool Validate () const
+	{
+		if (Size < sizeof(RecordedTrackFileHeader))
+			return false;
+
+		const RecordedTrackFileHeader & header = Header();
+		if (header.Magic != RecordedTrackFileMagic || header.Version != RecordedTrackFileVersion)
+			return false;
+
+		const uint64_t tableend = sizeof(RecordedTrackFileHeader) + static_cast<uint64_t>(header.TrackCount) * sizeof(RecordedTrackDescriptor);
+		if (tableend > Size)
+			return false;
+
+		for (size_t i = 0; i < header.TrackCount; ++i)
+		{
+			RecordedTrackDescriptor descriptor;
+			std::memcpy(&descriptor, Data + sizeof(RecordedTrackFileHeader) + i * sizeof(RecordedTrackDescriptor), sizeof(descriptor));
+
+			const uint64_t bytes = descriptor.SampleCount * sizeof(float);
+			if (descriptor.SampleCount > Size / sizeof(float)
+				|| (descriptor.TimesOffset | descriptor.ValuesOffset) % sizeof(float) != 0
+				|| descriptor.TimesOffset > Size || bytes > Size - descriptor.TimesOffset
+				|| descriptor.ValuesOffset > Size || bytes > Size - descriptor.ValuesOffset)
+				return false;
+		}
+
+		return true;
+	}
+
+	const unsigned char * Data;
+	size_t Size;
+
+#if defined(_WIN32)
+	HANDLE File;
+	HANDLE Mapping;
+#endif
+};
+
+
+//
+// Dynamic source playing back one recorded track, interpolating linearly
+// between samples and holding the first and last values outside them.
+//
+// Like the spline sources, it keeps a cursor on the last sample interval
+// it found, so steady playback never searches; seeking anywhere else is
+// a binary search over the mapped times. As the cursor moves it asks for
+// the next stretch of the track to be paged in ahead of time.
+//
+// A track the file doesn't have plays back as an empty one, holding
+// zero; HasTrack() tells the two apart.
+//
+class ValueSourceRecorded : public DynamicValueSource<float>
+{
+public:
+	ValueSourceRecorded (const RecordedTrackFile & file, size_t track, float time = 0.0f)
+		: File(&file),
+		  Time(time),
+		  Value(0.0f),
+		  Cursor(0),
+		  ReadaheadEnd(0)
+	{
+		Valid = file.GetTrack(track, Track);
+		Seek(time);
+	}
+
+
+	bool HasTrack () const
+	{
+		return Valid;
+	}
+
+
+	float GetCurrentValue () const override
+	{
+		return Value;
+	}
+
+
+	void Advance (float dt) override
+	{
+		Seek(Time + dt);
+	}
+
+
+	void FastForward (float dt, unsigned steps) override
+	{
+		Seek(Time + dt * static_cast<float>(steps));
+	}
+
+
+	void Seek (float time)
+	{
+		Time = time;
+		Value = Evaluate();
+	}
+
+	float GetTime () const
+	{
+		return Time;
+	}
+
+
+	size_t GetSnapshotSize () const override
+	{
+		return sizeof(Time);
+	}
+
+	void SaveSnapshot (void * buffer) const override
+	{
+		std::memcpy(buffer, &Time, sizeof(Time));
+	}
+
+	void RestoreSnapshot (const void * buffer) override
+	{
+		float time;
+		std::memcpy(&time, buffer, sizeof(time));
+		Seek(time);
+	}
+
+private:
+
+	// Samples per readahead window: 64KB worth of times and of values.
+	static const size_t ReadaheadSamples = 16384;
+
+
+	float Evaluate ()
+	{
+		const float * times = Track.Times;
+		const size_t count = Track.SampleCount;
+
+		if (count == 0)
+			return 0.0f;
+
+		if (Time <= times[0])
+		{
+			Cursor = 0;
+			return Track.Values[0];
+		}
+
+		if (Time >= times[count - 1])
+		{
+			Cursor = count - 1;
+			return Track.Values[count - 1];
+		}
+
+		if (Cursor >= count - 1 || Time < times[Cursor])
+		{
+			Cursor = Search(Time);
+		}
+		else
+		{
+			const unsigned maxsteps = 4;
+			unsigned steps = 0;
+			while (Time >= times[Cursor + 1] && steps < maxsteps)
+			{
+				++Cursor;
+				++steps;
+			}
+
+			if (Time >= times[Cursor + 1])
+				Cursor = Search(Time);
+		}
+
+		Readahead();
+
+		const float span = times[Cursor + 1] - times[Cursor];
+		const float u = span > 0.0f ? (Time - times[Cursor]) / span : 1.0f;
+		return Track.Values[Cursor] + (Track.Values[Cursor + 1] - Track.Values[Cursor]) * u;
+	}
+
+	size_t Search (float t) const
+	{
+		const float * iter = std::upper_bound(Track.Times, Track.Times + Track.SampleCount, t);
+		return static_cast<size_t>(iter - Track.Times) - 1;
+	}
+
+
+	//
+	// Once playback is halfway through the window requested last time,
+	// request the next one. Seeking backwards restarts the windows.
+	//
+	void Readahead ()
+	{
+		const bool inwindow = Cursor < ReadaheadEnd && Cursor + ReadaheadSamples >= ReadaheadEnd;
+		const bool nearend = Cursor + ReadaheadSamples / 2 >= ReadaheadEnd && ReadaheadEnd < Track.SampleCount;
+		if (inwindow && !nearend)
+			return;
+
+		const size_t begin = Cursor;
+		const size_t end = std::min(Cursor + ReadaheadSamples, Track.SampleCount);
+		File->WillNeed(Track.Times + begin, (end - begin) * sizeof(float));
+		File->WillNeed(Track.Values + begin, (end - begin) * sizeof(float));
+		ReadaheadEnd = end;
+	}
+
+
+	const RecordedTrackFile * File;
+	RecordedTrack Track;
+	bool Valid;
+	float Time;
+	float Value;
+	size_t Cursor;
+	size_t ReadaheadEnd;
+};
+
@@ -0,0 +1,376 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceClock.h"
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+
+//
+// Network-replicated value sources.
+//
+// The sending side periodically serializes the current values of a set
+// of sources into packets stamped with the sender's time. The receiving
+// side keeps a few of the most recent samples per object in a jitter
+// buffer and presents a value for "a little while ago", interpolating
+// between the samples around that time. This hides uneven packet arrival
+// completely as long as the delay covers the jitter; if packets stop
+// arriving, values are extrapolated for a bounded time and then hold.
+//
+
+
+//
+// How packets get from a sender to a receiver. Receive() fills the given
+// buffer with the next packet if there is one, reusing its storage.
+//
+class ReplicationTransport
+{
+public:
+	virtual ~ReplicationTransport () { }
+
+	virtual void Send (const void * data, size_t size) = 0;
+	virtual bool Receive (std::vector<unsigned char> & packet) = 0;
+};
+
+
+//
+// In-process stand-in for a real network, with optional simulated loss.
+// Safe to send and receive from different threads. Packet buffers are
+// recycled, so after warming up, passing packets allocates nothing.
+//
+class LoopbackTransport : public ReplicationTransport
+{
+public:
+	LoopbackTransport ()
+		: LossThreshold(0),
+		  RandomState(1)
+	{ }
+
+
+	//
+	// Drop each packet with the given probability, using a fixed seed
+	// so that lossy runs are repeatable.
+	//
+	void SetPacketLoss (float probability, uint32_t seed = 1)
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		LossThreshold = static_cast<uint32_t>(probability * 4294967295.0);
+		RandomState = seed ? seed : 1;
+	}
+
+
+	void Send (const void * data, size_t size) override
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+
+		if (LossThreshold && NextRandom() < LossThreshold)
+			return;
+
+		std::vector<unsigned char> packet;
+		if (!Recycled.empty())
+		{
+			packet.swap(Recycled.back());
+			Recycled.pop_back();
+		}
+
+		packet.resize(size);
+		std::memcpy(packet.data(), data, size);
+		Queue.emplace_back();
+		Queue.back().swap(packet);
+	}
+
+
+	bool Receive (std::vector<unsigned char> & packet) override
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+
+		if (Queue.empty())
+			return false;
+
+		Recycled.emplace_back();
+		Recycled.back().swap(packet);
+
+		packet.swap(Queue.front());
+		Queue.pop_front();
+		return true;
+	}
+
+private:
+	uint32_t NextRandom ()
+	{
+		RandomState ^= RandomState << 13;
+		RandomState ^= RandomState >> 17;
+		RandomState ^= RandomState << 5;
+		return RandomState;
+	}
+
+	std::mutex Mutex;
+	std::deque<std::vector<unsigned char>> Queue;
+	std::vector<std::vector<unsigned char>> Recycled;
+
+	uint32_t LossThreshold;
+	uint32_t RandomState;
+};
+
+
+//
+// Wire format: a header followed by (object id, value) pairs.
+//
+struct ReplicationPacketHeader
+{
+	uint32_t Magic;
+	uint32_t Count;
+	float Time;
+};
+
+struct ReplicationPacketEntry
+{
+	uint32_t Id;
+	float Value;
+};
+
+const uint32_t ReplicationPacketMagic = 0x50525356;		// "VSRP"
+
+
+//
+// Serializes sources into packets. Object ids are positions in the
+// array passed to Send(). Large worlds are split into packets of a
+// bounded number of entries, e.g. to fit a UDP datagram.
+//
+class ReplicationSender
+{
+public:
+	explicit ReplicationSender (size_t maxentriesperpacket = 0)
+		: MaxEntries(maxentriesperpacket)
+	{ }
+
+
+	void Send (ReplicationTransport & transport, float time, const ValueSource<float> * const * sources, size_t count)
+	{
+		const size_t perpacket = MaxEntries ? MaxEntries : count;
+
+		for (size_t first = 0; first < count; first += perpacket)
+		{
+			size_t entries = count - first < perpacket ? count - first : perpacket;
+			Buffer.resize(sizeof(ReplicationPacketHeader) + entries * sizeof(ReplicationPacketEntry));
+
+			ReplicationPacketHeader header = { ReplicationPacketMagic, static_cast<uint32_t>(entries), time };
+			std::memcpy(Buffer.data(), &header, sizeof(header));
+
+			unsigned char * out = Buffer.data() + sizeof(header);
+			for (size_t i = 0; i < entries; ++i)
+			{
+				ReplicationPacketEntry entry = { static_cast<uint32_t>(first + i), sources[first + i]->GetCurrentValue() };
+				std::memcpy(out, &entry, sizeof(entry));
+				out += sizeof(entry);
+			}
+
+			transport.Send(Buffer.data(), Buffer.size());
+		}
+	}
+
+private:
+	size_t MaxEntries;
+	std::vector<unsigned char> Buffer;
+};
+
+
+//
+// Tuning shared by all the sources of one receiver.
+//
+struct ReplicationSettings
+{
+	// How far behind the clock values are presented, in seconds; this
+	// should comfortably exceed the send interval plus network jitter.
+	float InterpolationDelay = 0.1f;
+
+	// How long to keep extrapolating after the newest sample runs out.
+	float MaxExtrapolation = 0.25f;
+};
+
+
+//
+// The receiving end of one replicated object.
+//
+class ValueSourceReplicated : public ValueSource<float>
+{
+public:
+	static const unsigned JitterCapacity = 8;
+
+
+	ValueSourceReplicated (const ValueSourceClock & clock, const ReplicationSettings & settings)
+		: Clock(&clock),
+		  Settings(&settings),
+		  Count(0)
+	{ }
+
+
+	//
+	// Insert a sample, keeping the buffer ordered by time. Samples that
+	// arrive late are slotted in place; duplicates and anything older
+	// than the whole buffer are ignored.
+	//
+	void PushSnapshot (float time, float value)
+	{
+		unsigned position = Count;
+		while (position > 0 && Times[position - 1] > time)
+			--position;
+
+		if (position > 0 && Times[position - 1] == time)
+			return;
+
+		if (Count == JitterCapacity)
+		{
+			if (position == 0)
+				return;
+
+			std::memmove(Times, Times + 1, (position - 1) * sizeof(float));
+			std::memmove(Values, Values + 1, (position - 1) * sizeof(float));
+			--position;
+		}
+		else
+		{
+			std::memmove(Times + position + 1, Times + position, (Count - position) * sizeof(float));
+			std::memmove(Values + position + 1, Values + position, (Count - position) * sizeof(float));
+			++Count;
+		}
+
+		Times[position] = time;
+		Values[position] = value;
+	}
+
+
+	float GetCurrentValue () const override
+	{
+		if (Count == 0)
+			return 0.0f;
+
+		const float t = Clock->GetTime() - Settings->InterpolationDelay;
+
+		if (Count == 1 || t <= Times[0])
+			return Values[0];
+
+		const unsigned newest = Count - 1;
+		if (t >= Times[newest])
+		{
+			float ahead = t - Times[newest];
+			if (ahead > Settings->MaxExtrapolation)
+				ahead = Settings->MaxExtrapolation;
+
+			float rate = (Values[newest] - Values[newest - 1]) / (Times[newest] - Times[newest - 1]);
+			return Values[newest] + rate * ahead;
+		}
+
+		unsigned next = 1;
+		while (Times[next] < t)
+			++next;
+
+		float u = (t - Times[next - 1]) / (Times[next] - Times[next - 1]);
+		return Values[next - 1] + (Values[next] - Values[next - 1]) * u;
+	}
+
+private:
+	const ValueSourceClock * Clock;
+	const ReplicationSettings * Settings;
+
+	float Times[JitterCapacity];
+	float Values[JitterCapacity];
+	unsigned Count;
+};
+
+
+//
+// Owns the replicated sources for one stream of objects and feeds them
+// from a transport.
+//
+// Pump() deserializes every pending packet straight into the sources,
+// with no allocation per packet or per object. It should run on the
+// thread that reads the sources (typically once at the top of a frame);
+// a dedicated network thread can still do all the socket work and hand
+// packets over through a thread-safe transport like LoopbackTransport.
+//
+class ReplicationReceiver
+{
+public:
+	ReplicationReceiver (size_t count, const ValueSourceClock & clock, const ReplicationSettings & settings = ReplicationSettings())
+		: Settings(settings)
+	{
+		Sources.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+			Sources.emplace_back(clock, Settings);
+	}
+
+	ReplicationReceiver (const ReplicationReceiver &) = delete;
+	ReplicationReceiver & operator = (const ReplicationReceiver &) = delete;
+
+
+	size_t GetCount () const
+	{
+		return Sources.size();
+	}
+
+	ValueSourceReplicated & GetSource (size_t id)
+	{
+		return Sources[id];
+	}
+
+	ReplicationSettings & GetSettings ()
+	{
+		return Settings;
+	}
+
+
+	//
+	// Returns the number of packets applied. Malformed packets and
+	// entries for unknown ids are skipped.
+	//
+	size_t Pump (ReplicationTransport & transport)
+	{
+		size_t packets = 0;
+		while (transport.Receive(Packet))
+		{
+			if (Apply(Packet.data(), Packet.size()))
+				++packets;
+		}
+
+		return packets;
+	}
+
+	bool Apply (const unsigned char * data, size_t size)
+	{
+		ReplicationPacketHeader header;
+		if (size < sizeof(header))
+			return false;
+
+		std::memcpy(&header, data, sizeof(header));
+		if (header.Magic != ReplicationPacketMagic)
+			return false;
+
+		if ((size - sizeof(header)) / sizeof(ReplicationPacketEntry) < header.Count)
+			return false;
+
+		const unsigned char * in = data + sizeof(header);
+		const size_t sourcecount = Sources.size();
+		for (uint32_t i = 0; i < header.Count; ++i)
+		{
+			ReplicationPacketEntry entry;
+			std::memcpy(&entry, in, sizeof(entry));
+			in += sizeof(entry);
+
+			if (entry.Id < sourcecount)
+				Sources[entry.Id].PushSnapshot(header.Time, entry.Value);
+		}
+
+		return true;
+	}
+
+private:
+	ReplicationSettings Settings;
+	std::vector<ValueSourceReplicated> Sources;
+	std::vector<unsigned char> Packet;
+};
+
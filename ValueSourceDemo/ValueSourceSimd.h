@@ -0,0 +1,112 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+
+//
+// Batched value sources want to stream through contiguous arrays of
+// floats using whatever vector width the target happens to offer. A
+// build may define VALUESOURCE_NO_SIMD to force the scalar fallbacks
+// everywhere, which is handy for checking that all the paths agree.
+//
+#if !defined(VALUESOURCE_NO_SIMD)
+
+#if defined(__AVX2__)
+#define VALUESOURCE_SIMD_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VALUESOURCE_SIMD_SSE 1
+#endif
+
+#endif
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(VALUESOURCE_SIMD_SSE)
+#include <emmintrin.h>
+#endif
+
+
+//
+// Everything that streams should start on a cache line boundary. That
+// covers the widest aligned vector loads we issue, and also means two
+// batches never share a line when they are advanced on separate cores.
+//
+const size_t ValueSourceCacheLineSize = 64;
+
+
+//
+// Minimal allocator handing out cache-line aligned blocks, so that SoA
+// storage can live in plain std::vectors and still be loaded with the
+// aligned vector instructions.
+//
+template <typename T, size_t Alignment = ValueSourceCacheLineSize>
+class AlignedAllocator
+{
+public:
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator () = default;
+
+	template <typename U>
+	AlignedAllocator (const AlignedAllocator<U, Alignment> &)
+	{ }
+
+
+	T * allocate (size_t count)
+	{
+		size_t bytes = count * sizeof(T);
+		if (bytes == 0)
+			bytes = Alignment;
+
+#if defined(_MSC_VER)
+		void * block = _aligned_malloc(bytes, Alignment);
+#else
+		void * block = nullptr;
+		if (posix_memalign(&block, Alignment, bytes) != 0)
+			block = nullptr;
+#endif
+
+		if (!block)
+			throw std::bad_alloc();
+
+		return static_cast<T *>(block);
+	}
+
+	void deallocate (T * block, size_t)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(block);
+#else
+		free(block);
+#endif
+	}
+};
+
+
+template <typename T, typename U, size_t Alignment>
+bool operator == (const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> &)
+{
+	return true;
+}
+
+template <typename T, typename U, size_t Alignment>
+bool operator != (const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> &)
+{
+	return false;
+}
+
@@ -0,0 +1,435 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceClock.h"
+#include "ValueSourceSimd.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+//
+// A keyframe track, interpolated with a Catmull-Rom spline.
+//
+// Each segment's cubic is worked out once when the track is built, so
+// evaluating it later is a single Horner step on four coefficients. The
+// end keys are repeated to give the first and last segments tangents.
+// Tracks are immutable and can be shared by any number of sources.
+//
+class ValueSourceSplineTrack
+{
+public:
+	struct Segment
+	{
+		float A;
+		float B;
+		float C;
+		float D;
+	};
+
+
+	//
+	// Key times must be strictly increasing, and there must be at least
+	// one key. A single key makes a track that holds that value, as one
+	// flat segment.
+	//
+	ValueSourceSplineTrack (const float * times, const float * values, size_t count)
+		: Times(times, times + count)
+	{
+		assert(count >= 1);
+
+		if (count == 1)
+		{
+			Segment flat = { values[0], 0.0f, 0.0f, 0.0f };
+			Segments.assign(1, flat);
+			return;
+		}
+
+		Segments.resize(count - 1);
+		for (size_t i = 0; i + 1 < count; ++i)
+		{
+			float p0 = values[i > 0 ? i - 1 : 0];
+			float p1 = values[i];
+			float p2 = values[i + 1];
+			float p3 = values[i + 2 < count ? i + 2 : count - 1];
+
+			Segment & segment = Segments[i];
+			segment.A = p1;
+			segment.B = 0.5f * (p2 - p0);
+			segment.C = 0.5f * (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3);
+			segment.D = 0.5f * (-p0 + 3.0f * p1 - 3.0f * p2 + p3);
+		}
+	}
+
+
+	float GetStartTime () const
+	{
+		return Times.front();
+	}
+
+	float GetEndTime () const
+	{
+		return Times.back();
+	}
+
+	size_t GetSegmentCount () const
+	{
+		return Segments.size();
+	}
+
+	const Segment & GetSegment (uint32_t index) const
+	{
+		return Segments[index];
+	}
+
+
+	//
+	// Find the segment containing time t, clamped to the track, and the
+	// position u within it. The cursor remembers the last segment found;
+	// when time moves forward steadily the answer is either the same
+	// segment or one of the next few, so no search is needed at all.
+	// Anything else falls back to a binary search.
+	//
+	uint32_t Locate (float t, uint32_t & cursor, float & u) const
+	{
+		const uint32_t last = static_cast<uint32_t>(Segments.size() - 1);
+
+		if (t <= Times.front())
+		{
+			cursor = 0;
+			u = 0.0f;
+			return cursor;
+		}
+
+		if (t >= Times.back())
+		{
+			cursor = last;
+			u = 1.0f;
+			return cursor;
+		}
+
+		if (cursor > last || t < Times[cursor])
+		{
+			cursor = Search(t);
+		}
+		else
+		{
+			const unsigned maxsteps = 4;
+			unsigned steps = 0;
+			while (t >= Times[cursor + 1] && steps < maxsteps)
+			{
+				++cursor;
+				++steps;
+			}
+
+			if (t >= Times[cursor + 1])
+				cursor = Search(t);
+		}
+
+		u = (t - Times[cursor]) / (Times[cursor + 1] - Times[cursor]);
+		return cursor;
+	}
+
+
+	float Evaluate (float t, uint32_t & cursor) const
+	{
+		float u;
+		const Segment & segment = Segments[Locate(t, cursor, u)];
+		return ((segment.D * u + segment.C) * u + segment.B) * u + segment.A;
+	}
+
+private:
+	uint32_t Search (float t) const
+	{
+		auto iter = std::upper_bound(Times.begin(), Times.end(), t);
+		return static_cast<uint32_t>((iter - Times.begin()) - 1);
+	}
+
+	std::vector<float> Times;
+	std::vector<Segment> Segments;
+};
+
+
+//
+// Reactive spline source, driven by time from outside just like the
+// ValueSourceLinearInterpolator: either set explicitly, or by following
+// a shared clock. Evaluation is likewise deferred until the value is
+// read, and reads may update the cached value and cursor.
+//
+class ValueSourceSpline : public ValueSource<float>
+{
+public:
+	explicit ValueSourceSpline (const ValueSourceSplineTrack & track, const ValueSourceClock * clock = nullptr) :
+		Track(&track),
+		Time(track.GetStartTime()),
+		Clock(clock),
+		Cursor(0),
+		CachedValue(0.0f),
+		CachedEpoch(0),
+		CacheValid(false)
+	{ }
+
+	float GetCurrentValue () const override
+	{
+		if (Clock)
+		{
+			if (!CacheValid || CachedEpoch != Clock->GetEpoch())
+			{
+				CachedValue = Track->Evaluate(Clock->GetTime(), Cursor);
+				CachedEpoch = Clock->GetEpoch();
+				CacheValid = true;
+			}
+		}
+		else if (!CacheValid)
+		{
+			CachedValue = Track->Evaluate(Time, Cursor);
+			CacheValid = true;
+		}
+
+		return CachedValue;
+	}
+
+	//
+	// Explicitly setting the time detaches from any clock.
+	//
+	void SetTime (float t)
+	{
+		Time = t;
+		Clock = nullptr;
+		CacheValid = false;
+	}
+
+	void AttachClock (const ValueSourceClock * clock)
+	{
+		Clock = clock;
+		CacheValid = false;
+	}
+
+private:
+	const ValueSourceSplineTrack * Track;
+	float Time;
+	const ValueSourceClock * Clock;
+
+	mutable uint32_t Cursor;
+	mutable float CachedValue;
+	mutable uint32_t CachedEpoch;
+	mutable bool CacheValid;
+};
+
+
+//
+// Dynamic spline source, which plays its track back as it is advanced.
+//
+class ValueSourceSplineFollower : public DynamicValueSource<float>
+{
+public:
+	explicit ValueSourceSplineFollower (const ValueSourceSplineTrack & track)
+		: Track(&track),
+		  Time(track.GetStartTime()),
+		  Cursor(0)
+	{
+		Value = Track->Evaluate(Time, Cursor);
+	}
+
+
+	float GetCurrentValue () const override
+	{
+		return Value;
+	}
+
+
+	void Advance (float dt) override
+	{
+		Time += dt;
+		Value = Track->Evaluate(Time, Cursor);
+	}
+
+
+	void FastForward (float dt, unsigned steps) override
+	{
+		Time += dt * static_cast<float>(steps);
+		Value = Track->Evaluate(Time, Cursor);
+	}
+
+
+	size_t GetSnapshotSize () const override
+	{
+		return sizeof(Time);
+	}
+
+	void SaveSnapshot (void * buffer) const override
+	{
+		std::memcpy(buffer, &Time, sizeof(Time));
+	}
+
+	void RestoreSnapshot (const void * buffer) override
+	{
+		std::memcpy(&Time, buffer, sizeof(Time));
+		Value = Track->Evaluate(Time, Cursor);
+	}
+
+private:
+	const ValueSourceSplineTrack * Track;
+	float Time;
+	uint32_t Cursor;
+	float Value;
+};
+
+
+//
+// Thousands of splines played back together, each on its own track and
+// at its own time.
+//
+// Evaluation runs in two passes. The first walks every spline's cursor
+// and gathers its segment coefficients and local position into staging
+// arrays; that part is inherently per-spline, but with cached cursors it
+// is only a couple of compares each. The second pass evaluates all the
+// cubics at once with vector arithmetic.
+//
+class ValueSourceSplineBatch
+{
+public:
+
+	//
+	// A view onto one spline, reading the values of the last Evaluate().
+	//
+	class View : public DynamicValueSource<float>
+	{
+	public:
+		View (const ValueSourceSplineBatch & batch, size_t index)
+			: Batch(&batch),
+			  Index(index)
+		{ }
+
+
+		float GetCurrentValue () const override
+		{
+			return Batch->Values[Index];
+		}
+
+
+		void Advance (float) override
+		{
+		}
+
+	private:
+		const ValueSourceSplineBatch * Batch;
+		size_t Index;
+	};
+
+
+	size_t Add (const ValueSourceSplineTrack & track, float time)
+	{
+		Tracks.push_back(&track);
+		Times.push_back(time);
+		Cursors.push_back(0);
+
+		A.push_back(0.0f);
+		B.push_back(0.0f);
+		C.push_back(0.0f);
+		D.push_back(0.0f);
+		U.push_back(0.0f);
+		Values.push_back(0.0f);
+
+		return Tracks.size() - 1;
+	}
+
+	size_t GetCount () const
+	{
+		return Tracks.size();
+	}
+
+	View GetView (size_t index) const
+	{
+		return View(*this, index);
+	}
+
+	float GetValue (size_t index) const
+	{
+		return Values[index];
+	}
+
+
+	//
+	// Move every spline's time forward and re-evaluate.
+	//
+	void Advance (float dt)
+	{
+		for (float & time : Times)
+			time += dt;
+
+		Evaluate();
+	}
+
+	void Evaluate ()
+	{
+		const size_t count = Tracks.size();
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			float u;
+			const ValueSourceSplineTrack::Segment & segment = Tracks[i]->GetSegment(Tracks[i]->Locate(Times[i], Cursors[i], u));
+			A[i] = segment.A;
+			B[i] = segment.B;
+			C[i] = segment.C;
+			D[i] = segment.D;
+			U[i] = u;
+		}
+
+		const float * a = A.data();
+		const float * b = B.data();
+		const float * c = C.data();
+		const float * d = D.data();
+		const float * u = U.data();
+		float * out = Values.data();
+
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 u8 = _mm256_load_ps(u + i);
+			__m256 r = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(d + i), u8), _mm256_load_ps(c + i));
+			r = _mm256_add_ps(_mm256_mul_ps(r, u8), _mm256_load_ps(b + i));
+			r = _mm256_add_ps(_mm256_mul_ps(r, u8), _mm256_load_ps(a + i));
+			_mm256_store_ps(out + i, r);
+		}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 u4 = _mm_load_ps(u + i);
+			__m128 r = _mm_add_ps(_mm_mul_ps(_mm_load_ps(d + i), u4), _mm_load_ps(c + i));
+			r = _mm_add_ps(_mm_mul_ps(r, u4), _mm_load_ps(b + i));
+			r = _mm_add_ps(_mm_mul_ps(r, u4), _mm_load_ps(a + i));
+			_mm_store_ps(out + i, r);
+		}
+#endif
+
+		for (; i < count; ++i)
+			out[i] = ((d[i] * u[i] + c[i]) * u[i] + b[i]) * u[i] + a[i];
+	}
+
+
+	void GetCurrentValues (size_t first, size_t count, float * out) const
+	{
+		std::memcpy(out, Values.data() + first, count * sizeof(float));
+	}
+
+private:
+	std::vector<const ValueSourceSplineTrack *> Tracks;
+	std::vector<float> Times;
+	std::vector<uint32_t> Cursors;
+
+	std::vector<float, AlignedAllocator<float>> A;
+	std::vector<float, AlignedAllocator<float>> B;
+	std::vector<float, AlignedAllocator<float>> C;
+	std::vector<float, AlignedAllocator<float>> D;
+	std::vector<float, AlignedAllocator<float>> U;
+	std::vector<float, AlignedAllocator<float>> Values;
+};
+
@@ -0,0 +1,357 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceSimd.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+
+//
+// Damped springs pulling a value towards a target.
+//
+// A spring is described by its natural angular frequency and damping
+// ratio: below one it is under-damped and overshoots, at exactly one it
+// is critically damped, and above one it is over-damped and creeps in.
+//
+// Stepping a spring by a fixed dt is exact and cheap. Over any interval
+// the displacement from the target and the velocity evolve by a fixed
+// linear map, so the exponentials and trig are evaluated once to build
+// that 2x2 matrix, and every tick afterwards is four multiplies. The
+// matrix is only rebuilt when dt changes, and fast-forwarding just
+// builds it for the whole interval at once.
+//
+struct SpringStep
+{
+	float M00;
+	float M01;
+	float M10;
+	float M11;
+
+
+	static SpringStep Compute (float frequency, float dampingratio, float t)
+	{
+		const double omega = frequency;
+		const double zeta = dampingratio;
+		const double time = t;
+
+		double m00, m01, m10, m11;
+
+		assert(frequency >= 0.0f);
+
+		if (omega == 0.0)
+		{
+			// No spring at all, so no damping either: the offset just
+			// keeps drifting at whatever velocity it has.
+			m00 = 1.0;
+			m01 = time;
+			m10 = 0.0;
+			m11 = 1.0;
+		}
+		else if (std::fabs(zeta - 1.0) < 1e-4)
+		{
+			double e = std::exp(-omega * time);
+			m00 = e * (1.0 + omega * time);
+			m01 = e * time;
+			m10 = -e * omega * omega * time;
+			m11 = e * (1.0 - omega * time);
+		}
+		else if (zeta < 1.0)
+		{
+			double damped = omega * std::sqrt(1.0 - zeta * zeta);
+			double e = std::exp(-zeta * omega * time);
+			double c = std::cos(damped * time);
+			double s = std::sin(damped * time) / damped;
+			m00 = e * (c + zeta * omega * s);
+			m01 = e * s;
+			m10 = -e * omega * omega * s;
+			m11 = e * (c - zeta * omega * s);
+		}
+		else
+		{
+			double root = omega * std::sqrt(zeta * zeta - 1.0);
+			double r1 = -zeta * omega + root;
+			double r2 = -zeta * omega - root;
+			double e1 = std::exp(r1 * time);
+			double e2 = std::exp(r2 * time);
+			double inv = 1.0 / (r1 - r2);
+			m00 = (r1 * e2 - r2 * e1) * inv;
+			m01 = (e1 - e2) * inv;
+			m10 = r1 * r2 * (e2 - e1) * inv;
+			m11 = (r1 * e1 - r2 * e2) * inv;
+		}
+
+		SpringStep step = { static_cast<float>(m00), static_cast<float>(m01), static_cast<float>(m10), static_cast<float>(m11) };
+		return step;
+	}
+};
+
+
+class ValueSourceSpring : public DynamicValueSource<float>
+{
+public:
+	ValueSourceSpring (float start, float target, float frequency, float dampingratio)
+		: Target(target),
+		  Offset(start - target),
+		  Velocity(0.0f),
+		  Frequency(frequency),
+		  DampingRatio(dampingratio),
+		  StepDT(0.0f),
+		  Step(SpringStep::Compute(frequency, dampingratio, 0.0f))
+	{ }
+
+
+	float GetCurrentValue () const override
+	{
+		return Target + Offset;
+	}
+
+
+	bool GetCurrentRate (float & rate) const override
+	{
+		rate = Velocity;
+		return true;
+	}
+
+
+	void Advance (float dt) override
+	{
+		if (dt != StepDT)
+		{
+			Step = SpringStep::Compute(Frequency, DampingRatio, dt);
+			StepDT = dt;
+		}
+
+		Apply(Step);
+	}
+
+
+	void FastForward (float dt, unsigned steps) override
+	{
+		Apply(SpringStep::Compute(Frequency, DampingRatio, dt * static_cast<float>(steps)));
+	}
+
+
+	//
+	// Retargeting keeps the current value and velocity, so the spring
+	// just starts pulling somewhere else.
+	//
+	void SetTarget (float target)
+	{
+		Offset += Target - target;
+		Target = target;
+	}
+
+
+	void SetCurrentValue (const float & value) override
+	{
+		Offset = value - Target;
+	}
+
+
+	size_t GetSnapshotSize () const override
+	{
+		return 3 * sizeof(float);
+	}
+
+	void SaveSnapshot (void * buffer) const override
+	{
+		float state[3] = { Target, Offset, Velocity };
+		std::memcpy(buffer, state, sizeof(state));
+	}
+
+	void RestoreSnapshot (const void * buffer) override
+	{
+		float state[3];
+		std::memcpy(state, buffer, sizeof(state));
+		Target = state[0];
+		Offset = state[1];
+		Velocity = state[2];
+	}
+
+private:
+	void Apply (const SpringStep & step)
+	{
+		float offset = step.M00 * Offset + step.M01 * Velocity;
+		Velocity = step.M10 * Offset + step.M11 * Velocity;
+		Offset = offset;
+	}
+
+	float Target;
+	float Offset;
+	float Velocity;
+
+	float Frequency;
+	float DampingRatio;
+	float StepDT;
+	SpringStep Step;
+};
+
+
+//
+// Many springs advanced together, stored as a structure of arrays.
+//
+// Each spring keeps its own step matrix, since frequency and damping
+// vary from one follower to the next. Those matrices are rebuilt only
+// when dt changes (or springs are added), which for a fixed timestep
+// means once; the per-tick work is then a branch-free vectorized 2x2
+// multiply over all springs.
+//
+class ValueSourceSpringBatch
+{
+public:
+
+	class View : public DynamicValueSource<float>
+	{
+	public:
+		View (const ValueSourceSpringBatch & batch, size_t index)
+			: Batch(&batch),
+			  Index(index)
+		{ }
+
+
+		float GetCurrentValue () const override
+		{
+			return Batch->GetValue(Index);
+		}
+
+
+		void Advance (float) override
+		{
+		}
+
+	private:
+		const ValueSourceSpringBatch * Batch;
+		size_t Index;
+	};
+
+
+	ValueSourceSpringBatch ()
+		: StepDT(0.0f),
+		  StepsValid(false)
+	{ }
+
+
+	size_t Add (float start, float target, float frequency, float dampingratio)
+	{
+		Targets.push_back(target);
+		Offsets.push_back(start - target);
+		Velocities.push_back(0.0f);
+		Frequencies.push_back(frequency);
+		DampingRatios.push_back(dampingratio);
+
+		M00.push_back(0.0f);
+		M01.push_back(0.0f);
+		M10.push_back(0.0f);
+		M11.push_back(0.0f);
+
+		StepsValid = false;
+		return Targets.size() - 1;
+	}
+
+	size_t GetCount () const
+	{
+		return Targets.size();
+	}
+
+	View GetView (size_t index) const
+	{
+		return View(*this, index);
+	}
+
+	float GetValue (size_t index) const
+	{
+		return Targets[index] + Offsets[index];
+	}
+
+	void SetTarget (size_t index, float target)
+	{
+		Offsets[index] += Targets[index] - target;
+		Targets[index] = target;
+	}
+
+
+	void Advance (float dt)
+	{
+		if (!StepsValid || dt != StepDT)
+		{
+			for (size_t i = 0; i < Targets.size(); ++i)
+			{
+				SpringStep step = SpringStep::Compute(Frequencies[i], DampingRatios[i], dt);
+				M00[i] = step.M00;
+				M01[i] = step.M01;
+				M10[i] = step.M10;
+				M11[i] = step.M11;
+			}
+
+			StepDT = dt;
+			StepsValid = true;
+		}
+
+		const size_t count = Targets.size();
+		float * x = Offsets.data();
+		float * v = Velocities.data();
+		const float * m00 = M00.data();
+		const float * m01 = M01.data();
+		const float * m10 = M10.data();
+		const float * m11 = M11.data();
+
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 x8 = _mm256_load_ps(x + i);
+			__m256 v8 = _mm256_load_ps(v + i);
+			__m256 nx = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(m00 + i), x8), _mm256_mul_ps(_mm256_load_ps(m01 + i), v8));
+			__m256 nv = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(m10 + i), x8), _mm256_mul_ps(_mm256_load_ps(m11 + i), v8));
+			_mm256_store_ps(x + i, nx);
+			_mm256_store_ps(v + i, nv);
+		}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x4 = _mm_load_ps(x + i);
+			__m128 v4 = _mm_load_ps(v + i);
+			__m128 nx = _mm_add_ps(_mm_mul_ps(_mm_load_ps(m00 + i), x4), _mm_mul_ps(_mm_load_ps(m01 + i), v4));
+			__m128 nv = _mm_add_ps(_mm_mul_ps(_mm_load_ps(m10 + i), x4), _mm_mul_ps(_mm_load_ps(m11 + i), v4));
+			_mm_store_ps(x + i, nx);
+			_mm_store_ps(v + i, nv);
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			float nx = m00[i] * x[i] + m01[i] * v[i];
+			v[i] = m10[i] * x[i] + m11[i] * v[i];
+			x[i] = nx;
+		}
+	}
+
+
+	void GetCurrentValues (size_t first, size_t count, float * out) const
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Targets[first + i] + Offsets[first + i];
+	}
+
+private:
+	std::vector<float, AlignedAllocator<float>> Targets;
+	std::vector<float, AlignedAllocator<float>> Offsets;
+	std::vector<float, AlignedAllocator<float>> Velocities;
+	std::vector<float> Frequencies;
+	std::vector<float> DampingRatios;
+
+	std::vector<float, AlignedAllocator<float>> M00;
+	std::vector<float, AlignedAllocator<float>> M01;
+	std::vector<float, AlignedAllocator<float>> M10;
+	std::vector<float, AlignedAllocator<float>> M11;
+
+	float StepDT;
+	bool StepsValid;
+};
+
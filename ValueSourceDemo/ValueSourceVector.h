@@ -0,0 +1,348 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceClock.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+
+//
+// Three-component vector, for positions and velocities in 3D.
+//
+struct Vec3
+{
+	float X;
+	float Y;
+	float Z;
+};
+
+inline Vec3 operator + (const Vec3 & a, const Vec3 & b)
+{
+	Vec3 result = { a.X + b.X, a.Y + b.Y, a.Z + b.Z };
+	return result;
+}
+
+inline Vec3 operator - (const Vec3 & a, const Vec3 & b)
+{
+	Vec3 result = { a.X - b.X, a.Y - b.Y, a.Z - b.Z };
+	return result;
+}
+
+inline Vec3 operator * (const Vec3 & v, float s)
+{
+	Vec3 result = { v.X * s, v.Y * s, v.Z * s };
+	return result;
+}
+
+inline Vec3 & operator += (Vec3 & a, const Vec3 & b)
+{
+	a.X += b.X;
+	a.Y += b.Y;
+	a.Z += b.Z;
+	return a;
+}
+
+
+//
+// Unit quaternion, for orientations.
+//
+struct Quaternion
+{
+	float W;
+	float X;
+	float Y;
+	float Z;
+
+
+	static Quaternion Identity ()
+	{
+		Quaternion q = { 1.0f, 0.0f, 0.0f, 0.0f };
+		return q;
+	}
+
+	static Quaternion FromAxisAngle (const Vec3 & axis, float angle)
+	{
+		const float length = std::sqrt(axis.X * axis.X + axis.Y * axis.Y + axis.Z * axis.Z);
+		const float s = std::sin(0.5f * angle) / length;
+		Quaternion q = { std::cos(0.5f * angle), axis.X * s, axis.Y * s, axis.Z * s };
+		return q;
+	}
+};
+
+inline float Dot (const Quaternion & a, const Quaternion & b)
+{
+	return a.W * b.W + a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+}
+
+
+//
+// The parameters of a slerp between two orientations, worked out once so
+// that evaluating at any t is two sines and a weighted sum.
+//
+// The end orientation is negated if need be so the path takes the short
+// way round, which keeps the angle between them within [0, pi/2]. When
+// the two are nearly identical the angle is nudged away from zero; the
+// resulting weights are then (1 - t) and t to within float precision,
+// which is exactly the lerp that is wanted there.
+//
+struct SlerpPath
+{
+	Quaternion From;
+	Quaternion To;
+	float Theta;
+	float InvSinTheta;
+
+
+	static SlerpPath Compute (const Quaternion & from, const Quaternion & to)
+	{
+		SlerpPath path;
+		path.From = from;
+		path.To = to;
+
+		float cosine = Dot(from, to);
+		if (cosine < 0.0f)
+		{
+			cosine = -cosine;
+			path.To.W = -to.W;
+			path.To.X = -to.X;
+			path.To.Y = -to.Y;
+			path.To.Z = -to.Z;
+		}
+
+		const float minimumtheta = 1e-3f;
+		path.Theta = std::acos(cosine < 1.0f ? cosine : 1.0f);
+		if (path.Theta < minimumtheta)
+			path.Theta = minimumtheta;
+
+		path.InvSinTheta = 1.0f / std::sin(path.Theta);
+		return path;
+	}
+
+
+	Quaternion Evaluate (float t) const
+	{
+		const float s0 = std::sin((1.0f - t) * Theta) * InvSinTheta;
+		const float s1 = std::sin(t * Theta) * InvSinTheta;
+
+		Quaternion q = { From.W * s0 + To.W * s1, From.X * s0 + To.X * s1, From.Y * s0 + To.Y * s1, From.Z * s0 + To.Z * s1 };
+		return q;
+	}
+};
+
+
+//
+// The linear accumulator, in 3D.
+//
+class ValueSourceVec3Accumulator : public DynamicValueSource<Vec3>
+{
+public:
+	ValueSourceVec3Accumulator (const Vec3 & start, const Vec3 & velocity)
+		: Value(start),
+		  Velocity(velocity)
+	{ }
+
+
+	Vec3 GetCurrentValue () const override
+	{
+		return Value;
+	}
+
+
+	bool GetCurrentRate (Vec3 & rate) const override
+	{
+		rate = Velocity;
+		return true;
+	}
+
+
+	void Advance (float dt) override
+	{
+		Value += Velocity * dt;
+	}
+
+
+	void FastForward (float dt, unsigned steps) override
+	{
+		Value += Velocity * (dt * static_cast<float>(steps));
+	}
+
+
+	void SetCurrentValue (const Vec3 & value) override
+	{
+		Value = value;
+	}
+
+
+	size_t GetSnapshotSize () const override
+	{
+		return sizeof(Value);
+	}
+
+	void SaveSnapshot (void * buffer) const override
+	{
+		std::memcpy(buffer, &Value, sizeof(Value));
+	}
+
+	void RestoreSnapshot (const void * buffer) override
+	{
+		std::memcpy(&Value, buffer, sizeof(Value));
+	}
+
+private:
+	Vec3 Value;
+	Vec3 Velocity;
+};
+
+
+//
+// The linear interpolator, in 3D. Lazy and clock-following in the same
+// way as the ValueSourceLinearInterpolator.
+//
+class ValueSourceVec3Interpolator : public ValueSource<Vec3>
+{
+public:
+	ValueSourceVec3Interpolator (const Vec3 & min, const Vec3 & max, const ValueSourceClock * clock = nullptr) :
+		Min(min),
+		Range(max - min),
+		Time(0.0f),
+		Clock(clock),
+		CachedValue(min),
+		CachedEpoch(0),
+		CacheValid(false)
+	{ }
+
+	Vec3 GetCurrentValue () const override
+	{
+		if (Clock)
+		{
+			if (!CacheValid || CachedEpoch != Clock->GetEpoch())
+			{
+				CachedValue = Evaluate(Clock->GetTime());
+				CachedEpoch = Clock->GetEpoch();
+				CacheValid = true;
+			}
+		}
+		else if (!CacheValid)
+		{
+			CachedValue = Evaluate(Time);
+			CacheValid = true;
+		}
+
+		return CachedValue;
+	}
+
+	//
+	// Explicitly setting the time detaches from any clock.
+	//
+	void SetTime (float t)
+	{
+		Time = t;
+		Clock = nullptr;
+		CacheValid = false;
+	}
+
+	void AttachClock (const ValueSourceClock * clock)
+	{
+		Clock = clock;
+		CacheValid = false;
+	}
+
+private:
+	Vec3 Evaluate (float t) const
+	{
+		if (t < 0.0f)
+			t = 0.0f;
+
+		if (t > 1.0f)
+			t = 1.0f;
+
+		return Min + Range * t;
+	}
+
+	Vec3 Min;
+	Vec3 Range;
+	float Time;
+	const ValueSourceClock * Clock;
+
+	mutable Vec3 CachedValue;
+	mutable uint32_t CachedEpoch;
+	mutable bool CacheValid;
+};
+
+
+//
+// Spherical interpolation between two orientations as time runs from zero
+// to one, at constant angular speed. Lazy and clock-following like the
+// other interpolators.
+//
+class ValueSourceSlerpInterpolator : public ValueSource<Quaternion>
+{
+public:
+	ValueSourceSlerpInterpolator (const Quaternion & from, const Quaternion & to, const ValueSourceClock * clock = nullptr) :
+		Path(SlerpPath::Compute(from, to)),
+		Time(0.0f),
+		Clock(clock),
+		CachedValue(from),
+		CachedEpoch(0),
+		CacheValid(false)
+	{ }
+
+	Quaternion GetCurrentValue () const override
+	{
+		if (Clock)
+		{
+			if (!CacheValid || CachedEpoch != Clock->GetEpoch())
+			{
+				CachedValue = Evaluate(Clock->GetTime());
+				CachedEpoch = Clock->GetEpoch();
+				CacheValid = true;
+			}
+		}
+		else if (!CacheValid)
+		{
+			CachedValue = Evaluate(Time);
+			CacheValid = true;
+		}
+
+		return CachedValue;
+	}
+
+	//
+	// Explicitly setting the time detaches from any clock.
+	//
+	void SetTime (float t)
+	{
+		Time = t;
+		Clock = nullptr;
+		CacheValid = false;
+	}
+
+	void AttachClock (const ValueSourceClock * clock)
+	{
+		Clock = clock;
+		CacheValid = false;
+	}
+
+private:
+	Quaternion Evaluate (float t) const
+	{
+		if (t < 0.0f)
+			t = 0.0f;
+
+		if (t > 1.0f)
+			t = 1.0f;
+
+		return Path.Evaluate(t);
+	}
+
+	SlerpPath Path;
+	float Time;
+	const ValueSourceClock * Clock;
+
+	mutable Quaternion CachedValue;
+	mutable uint32_t CachedEpoch;
+	mutable bool CacheValid;
+};
+
@@ -0,0 +1,527 @@
+#pragma once
+
+#include "ValueSource.h"
+#include "ValueSourceClock.h"
+#include "ValueSourceSimd.h"
+#include "ValueSourceVector.h"
+
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+
+//
+// Batches of 3D positions and orientations.
+//
+// These keep every component in its own array (X values together, then
+// Y, then Z) rather than an array of padded vectors. Each lane of a
+// vector register then holds the same component of a different entry,
+// so a single pass handles all three axes at full width, with no lanes
+// wasted on padding and no shuffling. Reads come out the same way, as
+// one array per component.
+//
+
+
+//
+// A population of 3D linear accumulators.
+//
+class ValueSourceVec3AccumulatorBatch
+{
+public:
+
+	//
+	// A view onto one entry. As with the float batch, Advance() does
+	// nothing; the batch steps every entry at once.
+	//
+	class View : public DynamicValueSource<Vec3>
+	{
+	public:
+		View (const ValueSourceVec3AccumulatorBatch & batch, size_t index)
+			: Batch(&batch),
+			  Index(index)
+		{ }
+
+
+		Vec3 GetCurrentValue () const override
+		{
+			return Batch->GetValue(Index);
+		}
+
+
+		void Advance (float) override
+		{
+		}
+
+	private:
+		const ValueSourceVec3AccumulatorBatch * Batch;
+		size_t Index;
+	};
+
+
+	void Reserve (size_t count)
+	{
+		for (auto * values : { &X, &Y, &Z, &VX, &VY, &VZ })
+			values->reserve(count);
+	}
+
+	size_t Add (const Vec3 & start, const Vec3 & velocity)
+	{
+		X.push_back(start.X);
+		Y.push_back(start.Y);
+		Z.push_back(start.Z);
+		VX.push_back(velocity.X);
+		VY.push_back(velocity.Y);
+		VZ.push_back(velocity.Z);
+		return X.size() - 1;
+	}
+
+	size_t GetCount () const
+	{
+		return X.size();
+	}
+
+	View GetView (size_t index) const
+	{
+		return View(*this, index);
+	}
+
+	Vec3 GetValue (size_t index) const
+	{
+		Vec3 value = { X[index], Y[index], Z[index] };
+		return value;
+	}
+
+
+	//
+	// Write the components of entries [first, first + count) to the
+	// three output arrays.
+	//
+	void GetCurrentValues (size_t first, size_t count, float * x, float * y, float * z) const
+	{
+		std::memcpy(x, X.data() + first, count * sizeof(float));
+		std::memcpy(y, Y.data() + first, count * sizeof(float));
+		std::memcpy(z, Z.data() + first, count * sizeof(float));
+	}
+
+
+	//
+	// All three axes in one streaming pass.
+	//
+	void Advance (float dt)
+	{
+		const size_t count = X.size();
+		float * x = X.data();
+		float * y = Y.data();
+		float * z = Z.data();
+		const float * vx = VX.data();
+		const float * vy = VY.data();
+		const float * vz = VZ.data();
+
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		const __m256 dt8 = _mm256_set1_ps(dt);
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm256_store_ps(x + i, _mm256_add_ps(_mm256_load_ps(x + i), _mm256_mul_ps(_mm256_load_ps(vx + i), dt8)));
+			_mm256_store_ps(y + i, _mm256_add_ps(_mm256_load_ps(y + i), _mm256_mul_ps(_mm256_load_ps(vy + i), dt8)));
+			_mm256_store_ps(z + i, _mm256_add_ps(_mm256_load_ps(z + i), _mm256_mul_ps(_mm256_load_ps(vz + i), dt8)));
+		}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+		const __m128 dt4 = _mm_set1_ps(dt);
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_store_ps(x + i, _mm_add_ps(_mm_load_ps(x + i), _mm_mul_ps(_mm_load_ps(vx + i), dt4)));
+			_mm_store_ps(y + i, _mm_add_ps(_mm_load_ps(y + i), _mm_mul_ps(_mm_load_ps(vy + i), dt4)));
+			_mm_store_ps(z + i, _mm_add_ps(_mm_load_ps(z + i), _mm_mul_ps(_mm_load_ps(vz + i), dt4)));
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			x[i] += vx[i] * dt;
+			y[i] += vy[i] * dt;
+			z[i] += vz[i] * dt;
+		}
+	}
+
+	void FastForward (float dt, unsigned steps)
+	{
+		Advance(dt * static_cast<float>(steps));
+	}
+
+
+	//
+	// Snapshots are the three position arrays back to back.
+	//
+	size_t GetSnapshotSize () const
+	{
+		return 3 * X.size() * sizeof(float);
+	}
+
+	void SaveSnapshot (void * buffer) const
+	{
+		GetCurrentValues(0, X.size(), static_cast<float *>(buffer), static_cast<float *>(buffer) + X.size(), static_cast<float *>(buffer) + 2 * X.size());
+	}
+
+	void RestoreSnapshot (const void * buffer)
+	{
+		const float * values = static_cast<const float *>(buffer);
+		std::memcpy(X.data(), values, X.size() * sizeof(float));
+		std::memcpy(Y.data(), values + X.size(), X.size() * sizeof(float));
+		std::memcpy(Z.data(), values + 2 * X.size(), X.size() * sizeof(float));
+	}
+
+private:
+	std::vector<float, AlignedAllocator<float>> X;
+	std::vector<float, AlignedAllocator<float>> Y;
+	std::vector<float, AlignedAllocator<float>> Z;
+	std::vector<float, AlignedAllocator<float>> VX;
+	std::vector<float, AlignedAllocator<float>> VY;
+	std::vector<float, AlignedAllocator<float>> VZ;
+};
+
+
+//
+// A population of 3D linear interpolators following one shared clock.
+//
+class ValueSourceVec3InterpolatorBatch
+{
+public:
+
+	class View : public ValueSource<Vec3>
+	{
+	public:
+		View (const ValueSourceVec3InterpolatorBatch & batch, size_t index)
+			: Batch(&batch),
+			  Index(index)
+		{ }
+
+
+		Vec3 GetCurrentValue () const override
+		{
+			return Batch->GetValue(Index);
+		}
+
+	private:
+		const ValueSourceVec3InterpolatorBatch * Batch;
+		size_t Index;
+	};
+
+
+	explicit ValueSourceVec3InterpolatorBatch (const ValueSourceClock & clock)
+		: Clock(&clock)
+	{ }
+
+
+	void Reserve (size_t count)
+	{
+		for (auto * values : { &MinX, &MinY, &MinZ, &RangeX, &RangeY, &RangeZ })
+			values->reserve(count);
+	}
+
+	size_t Add (const Vec3 & min, const Vec3 & max)
+	{
+		MinX.push_back(min.X);
+		MinY.push_back(min.Y);
+		MinZ.push_back(min.Z);
+		RangeX.push_back(max.X - min.X);
+		RangeY.push_back(max.Y - min.Y);
+		RangeZ.push_back(max.Z - min.Z);
+		return MinX.size() - 1;
+	}
+
+	size_t GetCount () const
+	{
+		return MinX.size();
+	}
+
+	View GetView (size_t index) const
+	{
+		return View(*this, index);
+	}
+
+	Vec3 GetValue (size_t index) const
+	{
+		const float t = GetClampedTime();
+		Vec3 value = { MinX[index] + RangeX[index] * t, MinY[index] + RangeY[index] * t, MinZ[index] + RangeZ[index] * t };
+		return value;
+	}
+
+
+	void GetCurrentValues (size_t first, size_t count, float * x, float * y, float * z) const
+	{
+		const float t = GetClampedTime();
+		Lerp(MinX.data() + first, RangeX.data() + first, t, x, count);
+		Lerp(MinY.data() + first, RangeY.data() + first, t, y, count);
+		Lerp(MinZ.data() + first, RangeZ.data() + first, t, z, count);
+	}
+
+private:
+	static void Lerp (const float * mins, const float * ranges, float t, float * out, size_t count)
+	{
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		const __m256 t8 = _mm256_set1_ps(t);
+		for (; i + 8 <= count; i += 8)
+			_mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(mins + i), _mm256_mul_ps(_mm256_loadu_ps(ranges + i), t8)));
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+		const __m128 t4 = _mm_set1_ps(t);
+		for (; i + 4 <= count; i += 4)
+			_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(mins + i), _mm_mul_ps(_mm_loadu_ps(ranges + i), t4)));
+#endif
+
+		for (; i < count; ++i)
+			out[i] = mins[i] + ranges[i] * t;
+	}
+
+	float GetClampedTime () const
+	{
+		float t = Clock->GetTime();
+
+		if (t < 0.0f)
+			t = 0.0f;
+
+		if (t > 1.0f)
+			t = 1.0f;
+
+		return t;
+	}
+
+	const ValueSourceClock * Clock;
+
+	std::vector<float, AlignedAllocator<float>> MinX;
+	std::vector<float, AlignedAllocator<float>> MinY;
+	std::vector<float, AlignedAllocator<float>> MinZ;
+	std::vector<float, AlignedAllocator<float>> RangeX;
+	std::vector<float, AlignedAllocator<float>> RangeY;
+	std::vector<float, AlignedAllocator<float>> RangeZ;
+};
+
+
+//
+// A population of slerps between orientations, following one shared
+// clock.
+//
+// Each entry's path is set up once when it is added, so evaluating the
+// batch never needs acos or a division. What's left per entry is two
+// sines, and since every angle involved lies within [0, pi/2], those
+// are a short odd polynomial that is accurate to float precision there
+// and vectorizes like any other arithmetic.
+//
+class ValueSourceSlerpBatch
+{
+public:
+
+	class View : public ValueSource<Quaternion>
+	{
+	public:
+		View (const ValueSourceSlerpBatch & batch, size_t index)
+			: Batch(&batch),
+			  Index(index)
+		{ }
+
+
+		Quaternion GetCurrentValue () const override
+		{
+			return Batch->GetValue(Index);
+		}
+
+	private:
+		const ValueSourceSlerpBatch * Batch;
+		size_t Index;
+	};
+
+
+	explicit ValueSourceSlerpBatch (const ValueSourceClock & clock)
+		: Clock(&clock)
+	{ }
+
+
+	size_t Add (const Quaternion & from, const Quaternion & to)
+	{
+		SlerpPath path = SlerpPath::Compute(from, to);
+
+		FromW.push_back(path.From.W);
+		FromX.push_back(path.From.X);
+		FromY.push_back(path.From.Y);
+		FromZ.push_back(path.From.Z);
+		ToW.push_back(path.To.W);
+		ToX.push_back(path.To.X);
+		ToY.push_back(path.To.Y);
+		ToZ.push_back(path.To.Z);
+		Theta.push_back(path.Theta);
+		InvSinTheta.push_back(path.InvSinTheta);
+
+		return Theta.size() - 1;
+	}
+
+	size_t GetCount () const
+	{
+		return Theta.size();
+	}
+
+	View GetView (size_t index) const
+	{
+		return View(*this, index);
+	}
+
+	Quaternion GetValue (size_t index) const
+	{
+		Quaternion q;
+		GetCurrentValues(index, 1, &q.W, &q.X, &q.Y, &q.Z);
+		return q;
+	}
+
+
+	//
+	// Write the components of entries [first, first + count) to the
+	// four output arrays.
+	//
+	void GetCurrentValues (size_t first, size_t count, float * w, float * x, float * y, float * z) const
+	{
+		const float t = GetClampedTime();
+		const float * fw = FromW.data() + first;
+		const float * fx = FromX.data() + first;
+		const float * fy = FromY.data() + first;
+		const float * fz = FromZ.data() + first;
+		const float * tw = ToW.data() + first;
+		const float * tx = ToX.data() + first;
+		const float * ty = ToY.data() + first;
+		const float * tz = ToZ.data() + first;
+		const float * theta = Theta.data() + first;
+		const float * invsin = InvSinTheta.data() + first;
+
+		size_t i = 0;
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+		const __m256 t8 = _mm256_set1_ps(t);
+		const __m256 u8 = _mm256_set1_ps(1.0f - t);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 angle = _mm256_loadu_ps(theta + i);
+			__m256 inv = _mm256_loadu_ps(invsin + i);
+			__m256 s0 = _mm256_mul_ps(Sin(_mm256_mul_ps(u8, angle)), inv);
+			__m256 s1 = _mm256_mul_ps(Sin(_mm256_mul_ps(t8, angle)), inv);
+
+			_mm256_storeu_ps(w + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(fw + i), s0), _mm256_mul_ps(_mm256_loadu_ps(tw + i), s1)));
+			_mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(fx + i), s0), _mm256_mul_ps(_mm256_loadu_ps(tx + i), s1)));
+			_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(fy + i), s0), _mm256_mul_ps(_mm256_loadu_ps(ty + i), s1)));
+			_mm256_storeu_ps(z + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(fz + i), s0), _mm256_mul_ps(_mm256_loadu_ps(tz + i), s1)));
+		}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+		const __m128 t4 = _mm_set1_ps(t);
+		const __m128 u4 = _mm_set1_ps(1.0f - t);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 angle = _mm_loadu_ps(theta + i);
+			__m128 inv = _mm_loadu_ps(invsin + i);
+			__m128 s0 = _mm_mul_ps(Sin(_mm_mul_ps(u4, angle)), inv);
+			__m128 s1 = _mm_mul_ps(Sin(_mm_mul_ps(t4, angle)), inv);
+
+			_mm_storeu_ps(w + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(fw + i), s0), _mm_mul_ps(_mm_loadu_ps(tw + i), s1)));
+			_mm_storeu_ps(x + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(fx + i), s0), _mm_mul_ps(_mm_loadu_ps(tx + i), s1)));
+			_mm_storeu_ps(y + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(fy + i), s0), _mm_mul_ps(_mm_loadu_ps(ty + i), s1)));
+			_mm_storeu_ps(z + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(fz + i), s0), _mm_mul_ps(_mm_loadu_ps(tz + i), s1)));
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			float s0 = Sin((1.0f - t) * theta[i]) * invsin[i];
+			float s1 = Sin(t * theta[i]) * invsin[i];
+
+			w[i] = fw[i] * s0 + tw[i] * s1;
+			x[i] = fx[i] * s0 + tx[i] * s1;
+			y[i] = fy[i] * s0 + ty[i] * s1;
+			z[i] = fz[i] * s0 + tz[i] * s1;
+		}
+	}
+
+private:
+
+	//
+	// sin(a) for a in [0, pi/2], from its Taylor series up to a^11; the
+	// first term left out is below 6e-8 over that whole range.
+	//
+	static float Sin (float a)
+	{
+		const float a2 = a * a;
+		float r = SinC11;
+		r = r * a2 + SinC9;
+		r = r * a2 + SinC7;
+		r = r * a2 + SinC5;
+		r = r * a2 + SinC3;
+		r = r * a2 + 1.0f;
+		return r * a;
+	}
+
+#if defined(VALUESOURCE_SIMD_AVX2)
+	static __m256 Sin (__m256 a)
+	{
+		const __m256 a2 = _mm256_mul_ps(a, a);
+		__m256 r = _mm256_set1_ps(SinC11);
+		r = _mm256_add_ps(_mm256_mul_ps(r, a2), _mm256_set1_ps(SinC9));
+		r = _mm256_add_ps(_mm256_mul_ps(r, a2), _mm256_set1_ps(SinC7));
+		r = _mm256_add_ps(_mm256_mul_ps(r, a2), _mm256_set1_ps(SinC5));
+		r = _mm256_add_ps(_mm256_mul_ps(r, a2), _mm256_set1_ps(SinC3));
+		r = _mm256_add_ps(_mm256_mul_ps(r, a2), _mm256_set1_ps(1.0f));
+		return _mm256_mul_ps(r, a);
+	}
+#endif
+
+#if defined(VALUESOURCE_SIMD_SSE)
+	static __m128 Sin (__m128 a)
+	{
+		const __m128 a2 = _mm_mul_ps(a, a);
+		__m128 r = _mm_set1_ps(SinC11);
+		r = _mm_add_ps(_mm_mul_ps(r, a2), _mm_set1_ps(SinC9));
+		r = _mm_add_ps(_mm_mul_ps(r, a2), _mm_set1_ps(SinC7));
+		r = _mm_add_ps(_mm_mul_ps(r, a2), _mm_set1_ps(SinC5));
+		r = _mm_add_ps(_mm_mul_ps(r, a2), _mm_set1_ps(SinC3));
+		r = _mm_add_ps(_mm_mul_ps(r, a2), _mm_set1_ps(1.0f));
+		return _mm_mul_ps(r, a);
+	}
+#endif
+
+	static constexpr float SinC3 = -1.0f / 6.0f;
+	static constexpr float SinC5 = 1.0f / 120.0f;
+	static constexpr float SinC7 = -1.0f / 5040.0f;
+	static constexpr float SinC9 = 1.0f / 362880.0f;
+	static constexpr float SinC11 = -1.0f / 39916800.0f;
+
+
+	float GetClampedTime () const
+	{
+		float t = Clock->GetTime();
+
+		if (t < 0.0f)
+			t = 0.0f;
+
+		if (t > 1.0f)
+			t = 1.0f;
+
+		return t;
+	}
+
+	const ValueSourceClock * Clock;
+
+	std::vector<float, AlignedAllocator<float>> FromW;
+	std::vector<float, AlignedAllocator<float>> FromX;
+	std::vector<float, AlignedAllocator<float>> FromY;
+	std::vector<float, AlignedAllocator<float>> FromZ;
+	std::vector<float, AlignedAllocator<float>> ToW;
+	std::vector<float, AlignedAllocator<float>> ToX;
+	std::vector<float, AlignedAllocator<float>> ToY;
+	std::vector<float, AlignedAllocator<float>> ToZ;
+	std::vector<float, AlignedAllocator<float>> Theta;
+	std::vector<float, AlignedAllocator<float>> InvSinTheta;
+};
+
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "MovingObjects.h"
+#include "ValueSourceBuckets.h"
+#include "ValueSourceSimd.h"
+#include "WorkStealingThreadPool.h"
+
+#include <utility>
+#include <vector>
+
+
+//
+// A simulation world owning a population of dynamic-value-source driven
+// objects along with the sources feeding them, and advancing all of
+// them across a thread pool.
+//
+// Every object is advanced exactly once per tick, independently of all
+// the others, so the outcome of a tick is bit-for-bit identical no matter
+// how many threads took part or how the chunks were scheduled.
+//
+class ValueSourceWorld
+{
+public:
+
+	//
+	// Chunks are always a whole multiple of this many sources. Each
+	// source type's storage starts on a cache line boundary, so chunk
+	// edges land on line boundaries for any size of source, and no two
+	// workers ever write to the same line.
+	//
+	static const size_t ChunkAlignment = ValueSourceCacheLineSize;
+
+
+	explicit ValueSourceWorld (WorkStealingThreadPool & pool, size_t grain = 16 * ChunkAlignment)
+		: Pool(pool),
+		  Grain(RoundGrain(grain))
+	{ }
+
+
+	//
+	// Create a source and an object attached to it, returning the index
+	// of the new object.
+	//
+	template <typename SourceT, typename... Args>
+	size_t Spawn (Args &&... args)
+	{
+		auto handle = Sources.Emplace<SourceT>(std::forward<Args>(args)...);
+
+		Objects.emplace_back();
+		Objects.back().AttachPositionValueSource(Sources.Get(handle));
+		return Objects.size() - 1;
+	}
+
+
+	size_t GetObjectCount () const
+	{
+		return Objects.size();
+	}
+
+	DynamicValueSourceDemo::MovingObject & GetObject (size_t index)
+	{
+		return Objects[index];
+	}
+
+	const DynamicValueSourceDemo::MovingObject & GetObject (size_t index) const
+	{
+		return Objects[index];
+	}
+
+
+	//
+	// Objects only hand Advance() on to their sources, so rather than
+	// going through every object, the sources are advanced directly, one
+	// type at a time with statically dispatched calls, and each type's
+	// storage split across the pool.
+	//
+	void Advance (float dt)
+	{
+		for (size_t bucket = 0; bucket < Sources.GetBucketCount(); ++bucket)
+		{
+			DynamicValueSourceBuckets<float> & sources = Sources;
+
+			Pool.ParallelFor(Sources.GetSlotCount(bucket), Grain, [&sources, bucket, dt] (size_t begin, size_t end)
+			{
+				sources.AdvanceRange(bucket, dt, begin, end);
+			});
+		}
+	}
+
+private:
+	static size_t RoundGrain (size_t grain)
+	{
+		size_t rounded = (grain + ChunkAlignment - 1) / ChunkAlignment * ChunkAlignment;
+		return rounded ? rounded : ChunkAlignment;
+	}
+
+
+	WorkStealingThreadPool & Pool;
+	size_t Grain;
+
+	DynamicValueSourceBuckets<float> Sources;
+	std::vector<DynamicValueSourceDemo::MovingObject, AlignedAllocator<DynamicValueSourceDemo::MovingObject>> Objects;
+};
+
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "ValueSourceSimd.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+//
+// A small fork/join pool for splitting a tick across cores.
+//
+// Each worker owns a queue of tasks. Work is handed out in contiguous
+// blocks, so a worker normally chews through its own block front to
+// back; when it runs dry it steals from the other end of somebody else's
+// queue. The thread calling ParallelFor() helps out rather than idling,
+// and returns once every chunk of its job has run.
+//
+// The pool says nothing about ordering between chunks. Callers get
+// deterministic results by making chunks independent of one another,
+// which is naturally the case when every element is advanced alone.
+//
+class WorkStealingThreadPool
+{
+public:
+	explicit WorkStealingThreadPool (unsigned workers = GetDefaultWorkerCount())
+		: Pending(0),
+		  Stopping(false)
+	{
+		for (unsigned i = 0; i < workers; ++i)
+			Queues.emplace_back(new WorkerQueue);
+
+		for (unsigned i = 0; i < workers; ++i)
+			Workers.emplace_back(&WorkStealingThreadPool::WorkerLoop, this, i);
+	}
+
+	~WorkStealingThreadPool ()
+	{
+		{
+			std::lock_guard<std::mutex> lock(WakeMutex);
+			Stopping = true;
+		}
+		WakeCondition.notify_all();
+
+		for (auto & worker : Workers)
+			worker.join();
+	}
+
+	WorkStealingThreadPool (const WorkStealingThreadPool &) = delete;
+	WorkStealingThreadPool & operator = (const WorkStealingThreadPool &) = delete;
+
+
+	//
+	// The calling thread participates too, so leave one core for it.
+	//
+	static unsigned GetDefaultWorkerCount ()
+	{
+		unsigned cores = std::thread::hardware_concurrency();
+		return cores > 1 ? cores - 1 : 0;
+	}
+
+	unsigned GetWorkerCount () const
+	{
+		return static_cast<unsigned>(Workers.size());
+	}
+
+
+	//
+	// Invoke function(begin, end) over [0, count) in chunks of at most
+	// grain elements, and block until all of them have completed.
+	//
+	template <typename Function>
+	void ParallelFor (size_t count, size_t grain, const Function & function)
+	{
+		if (count == 0)
+			return;
+
+		if (grain == 0)
+			grain = 1;
+
+		const size_t chunks = (count + grain - 1) / grain;
+		if (Queues.empty() || chunks == 1)
+		{
+			function(size_t(0), count);
+			return;
+		}
+
+		Job job;
+		job.Context = &function;
+		job.Invoke = &InvokeFunction<Function>;
+		job.Remaining.store(chunks, std::memory_order_relaxed);
+
+		const size_t queuecount = Queues.size();
+		for (size_t q = 0; q < queuecount; ++q)
+		{
+			size_t first = q * chunks / queuecount;
+			size_t last = (q + 1) * chunks / queuecount;
+			if (first == last)
+				continue;
+
+			std::lock_guard<std::mutex> lock(Queues[q]->Mutex);
+			for (size_t c = first; c < last; ++c)
+			{
+				Task task = { &job, c * grain, std::min(count, (c + 1) * grain) };
+				Queues[q]->Tasks.push_back(task);
+			}
+		}
+
+		//
+		// Only count the tasks in once they are all queued, so a worker
+		// woken by the count always finds something to take. One that was
+		// already awake may take a task first, which just leaves the count
+		// briefly below zero.
+		//
+		{
+			std::lock_guard<std::mutex> lock(WakeMutex);
+			Pending.fetch_add(static_cast<std::ptrdiff_t>(chunks), std::memory_order_relaxed);
+		}
+
+		WakeCondition.notify_all();
+
+		while (job.Remaining.load(std::memory_order_acquire) > 0)
+		{
+			Task task;
+			if (Steal(0, task))
+				Run(task);
+			else
+				std::this_thread::yield();
+		}
+	}
+
+private:
+
+	struct Job
+	{
+		const void * Context;
+		void (*Invoke) (const void * context, size_t begin, size_t end);
+		std::atomic<size_t> Remaining;
+	};
+
+	struct Task
+	{
+		Job * Owner;
+		size_t Begin;
+		size_t End;
+	};
+
+	//
+	// Padded out so that two queues never share a cache line.
+	//
+	struct WorkerQueue
+	{
+		std::mutex Mutex;
+		std::deque<Task> Tasks;
+		char Padding[ValueSourceCacheLineSize];
+	};
+
+
+	template <typename Function>
+	static void InvokeFunction (const void * context, size_t begin, size_t end)
+	{
+		(*static_cast<const Function *>(context))(begin, end);
+	}
+
+	static void Run (const Task & task)
+	{
+		task.Owner->Invoke(task.Owner->Context, task.Begin, task.End);
+		task.Owner->Remaining.fetch_sub(1, std::memory_order_release);
+	}
+
+
+	bool PopLocal (size_t index, Task & task)
+	{
+		WorkerQueue & queue = *Queues[index];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if (queue.Tasks.empty())
+			return false;
+
+		task = queue.Tasks.front();
+		queue.Tasks.pop_front();
+		Pending.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool Steal (size_t start, Task & task)
+	{
+		const size_t queuecount = Queues.size();
+		for (size_t i = 0; i < queuecount; ++i)
+		{
+			WorkerQueue & queue = *Queues[(start + i) % queuecount];
+			std::lock_guard<std::mutex> lock(queue.Mutex);
+			if (queue.Tasks.empty())
+				continue;
+
+			task = queue.Tasks.back();
+			queue.Tasks.pop_back();
+			Pending.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		return false;
+	}
+
+
+	void WorkerLoop (size_t index)
+	{
+		for (;;)
+		{
+			Task task;
+			if (PopLocal(index, task) || Steal(index + 1, task))
+			{
+				Run(task);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(WakeMutex);
+			WakeCondition.wait(lock, [this] { return Stopping || Pending.load(std::memory_order_relaxed) > 0; });
+
+			if (Stopping && Pending.load(std::memory_order_relaxed) <= 0)
+				return;
+		}
+	}
+
+
+	std::vector<std::unique_ptr<WorkerQueue>> Queues;
+	std::vector<std::thread> Workers;
+
+	//
+	// Tasks queued but not yet taken. Signed, since tasks can be taken
+	// before they are counted.
+	//
+	std::atomic<std::ptrdiff_t> Pending;
+	std::mutex WakeMutex;
+	std::condition_variable WakeCondition;
+	bool Stopping;
+};
+
@@ -0,0 +1,474 @@
+//
+// Headless simulation driver.
+//
+// This runs the same kind of update/present loop as the demo's main(),
+// but with the population, tick count, time step and output all chosen
+// on the command line, and with nothing rendered unless asked for. It
+// is the entry point for load testing and profiling the engine.
+//
+// A summary of the run goes to stderr, so that stdout carries nothing
+// but rendered frames when an output mode is selected.
+//
+
+#include "FixedTimestep.h"
+#include "FrameRenderer.h"
+#include "MovingObjects.h"
+#include "StaticValueSource.h"
+#include "ValueSourceAccumulator.h"
+#include "ValueSourceAccumulatorBatch.h"
+#include "ValueSourceClock.h"
+#include "ValueSourceLinearInterpolator.h"
+#include "ValueSourceWorld.h"
+#include "WorkStealingThreadPool.h"
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+	enum class OutputMode
+	{
+		None,
+		Text,
+		Binary
+	};
+
+
+	struct Options
+	{
+		size_t Classic = 0;
+		size_t Dynamic = 0;
+		size_t Static = 0;
+		size_t Reactive = 0;
+		size_t Batched = 0;
+
+		unsigned Ticks = 100;
+		float DT = 0.1f;
+		unsigned Threads = 0;
+		float RenderRate = 0.0f;
+
+		OutputMode Output = OutputMode::None;
+		bool AsyncOutput = false;
+		bool Verify = false;
+	};
+
+
+	void PrintUsage (const char * program)
+	{
+		std::fprintf(stderr,
+			"Usage: %s [options]\n"
+			"\n"
+			"Population (objects per design, all default to 0):\n"
+			"  --classic N      classic objects with their own state\n"
+			"  --dynamic N      dynamic value source objects, advanced by a world\n"
+			"  --static N       statically dispatched value source objects\n"
+			"  --reactive N     reactive objects following a shared clock\n"
+			"  --batched N      objects attached to a batched accumulator\n"
+			"\n"
+			"Simulation:\n"
+			"  --ticks N        number of ticks to run (default 100)\n"
+			"  --dt X           time step per tick (default 0.1)\n"
+			"  --threads N      worker threads for the world advance (default 0)\n"
+			"  --render-hz X    present at this rate, blending between ticks\n"
+			"                   (default 0: present once per tick)\n"
+			"\n"
+			"Output:\n"
+			"  --output MODE    none, text or binary (default none)\n"
+			"  --async          write frames from a background thread\n"
+			"\n"
+			"Checking:\n"
+			"  --verify         fail unless every object of every design ends\n"
+			"                   where its start and velocity put it\n",
+			program);
+	}
+
+
+	//
+	// Option values must parse in full; anything with trailing junk, a
+	// sign on a count, or a number out of range is rejected.
+	//
+	bool ParseCount (const char * value, size_t & count)
+	{
+		if (!std::isdigit(static_cast<unsigned char>(value[0])))
+			return false;
+
+		char * end = nullptr;
+		errno = 0;
+		unsigned long long parsed = std::strtoull(value, &end, 10);
+		if (*end || errno == ERANGE || parsed > std::numeric_limits<size_t>::max())
+			return false;
+
+		count = static_cast<size_t>(parsed);
+		return true;
+	}
+
+	bool ParseCount (const char * value, unsigned & count)
+	{
+		size_t parsed;
+		if (!ParseCount(value, parsed) || parsed > std::numeric_limits<unsigned>::max())
+			return false;
+
+		count = static_cast<unsigned>(parsed);
+		return true;
+	}
+
+	bool ParseFloat (const char * value, float & number)
+	{
+		char * end = nullptr;
+		float parsed = std::strtof(value, &end);
+		if (end == value || *end || !std::isfinite(parsed))
+			return false;
+
+		number = parsed;
+		return true;
+	}
+
+
+	bool ParseOptions (int argc, char * argv[], Options & options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+
+			if (arg == "--async")
+			{
+				options.AsyncOutput = true;
+				continue;
+			}
+
+			if (arg == "--verify")
+			{
+				options.Verify = true;
+				continue;
+			}
+
+			if (i + 1 >= argc)
+				return false;
+
+			const char * value = argv[++i];
+
+			bool valid = true;
+			if (arg == "--classic")
+				valid = ParseCount(value, options.Classic);
+			else if (arg == "--dynamic")
+				valid = ParseCount(value, options.Dynamic);
+			else if (arg == "--static")
+				valid = ParseCount(value, options.Static);
+			else if (arg == "--reactive")
+				valid = ParseCount(value, options.Reactive);
+			else if (arg == "--batched")
+				valid = ParseCount(value, options.Batched);
+			else if (arg == "--ticks")
+				valid = ParseCount(value, options.Ticks);
+			else if (arg == "--dt")
+				valid = ParseFloat(value, options.DT) && options.DT > 0.0f;
+			else if (arg == "--threads")
+				valid = ParseCount(value, options.Threads);
+			else if (arg == "--render-hz")
+				valid = ParseFloat(value, options.RenderRate) && options.RenderRate >= 0.0f;
+			else if (arg == "--output")
+			{
+				if (!std::strcmp(value, "none"))
+					options.Output = OutputMode::None;
+				else if (!std::strcmp(value, "text"))
+					options.Output = OutputMode::Text;
+				else if (!std::strcmp(value, "binary"))
+					options.Output = OutputMode::Binary;
+				else
+					return false;
+			}
+			else
+				return false;
+
+			if (!valid)
+				return false;
+		}
+
+		return true;
+	}
+
+
+	//
+	// Same deterministic population as the benchmark.
+	//
+	float GetStart (size_t index)
+	{
+		return static_cast<float>(index % 1000) * 0.01f;
+	}
+
+	float GetVelocity (size_t index)
+	{
+		return 1.0f + static_cast<float>(index % 7);
+	}
+
+
+	//
+	// Every design moves its objects along the same straight paths, so
+	// after the run each object should sit where its start and velocity
+	// put it. The designs round differently along the way, hence the
+	// tolerance; anything that stops early or skips ticks is far off.
+	//
+	bool IsOnPath (size_t index, float time, float position)
+	{
+		const double expected = static_cast<double>(GetStart(index)) + static_cast<double>(GetVelocity(index)) * time;
+		return std::fabs(position - expected) <= 1e-3 * (1.0 + std::fabs(expected));
+	}
+
+}
+
+
+int main (int argc, char * argv[])
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+
+	//
+	// Set up every population up front, so the timed loop is nothing
+	// but ticking.
+	//
+	std::vector<ClassicDesignDemo::MovingObject> classicobjects;
+	classicobjects.reserve(options.Classic);
+	for (size_t i = 0; i < options.Classic; ++i)
+		classicobjects.emplace_back(GetStart(i), GetVelocity(i));
+
+	WorkStealingThreadPool pool(options.Threads);
+	ValueSourceWorld world(pool);
+	for (size_t i = 0; i < options.Dynamic; ++i)
+		world.Spawn<ValueSourceLinearAccumulator>(GetStart(i), GetVelocity(i));
+
+	typedef StaticDispatchDemo::MovingObject<StaticValueSourceLinearAccumulator> StaticObject;
+	std::vector<StaticObject> staticobjects;
+	staticobjects.reserve(options.Static);
+	for (size_t i = 0; i < options.Static; ++i)
+		staticobjects.emplace_back(StaticValueSourceLinearAccumulator(GetStart(i), GetVelocity(i)));
+
+	//
+	// The shared clock runs from zero to one over the whole run, and each
+	// interpolator spans the distance an accumulator covers in that time,
+	// so the reactive objects keep moving to the end like the others.
+	//
+	const float duration = options.DT * static_cast<float>(options.Ticks);
+
+	ValueSourceClock clock;
+	std::vector<ValueSourceLinearInterpolator> interpolators;
+	std::vector<ReactiveProgrammingDemo::MovingObject> reactiveobjects(options.Reactive);
+	interpolators.reserve(options.Reactive);
+	for (size_t i = 0; i < options.Reactive; ++i)
+	{
+		interpolators.emplace_back(GetStart(i), GetStart(i) + GetVelocity(i) * duration, &clock);
+		reactiveobjects[i].AttachPositionValueSource(&interpolators.back());
+	}
+
+	ValueSourceLinearAccumulatorBatch batch;
+	std::vector<ValueSourceLinearAccumulatorBatch::View> views;
+	std::vector<DynamicValueSourceDemo::MovingObject> batchedobjects(options.Batched);
+	batch.Reserve(options.Batched);
+	views.reserve(options.Batched);
+	for (size_t i = 0; i < options.Batched; ++i)
+	{
+		batch.Add(GetStart(i), GetVelocity(i));
+		views.push_back(batch.GetView(i));
+		batchedobjects[i].AttachPositionValueSource(&views.back());
+	}
+
+	std::unique_ptr<FrameRenderer> renderer;
+	if (options.Output != OutputMode::None)
+	{
+		FrameRenderer::Mode mode = options.Output == OutputMode::Text ? FrameRenderer::Mode::Text : FrameRenderer::Mode::Binary;
+		renderer.reset(new FrameRenderer(stdout, mode, options.AsyncOutput));
+	}
+
+
+	//
+	// One tick of every population, shared by both loops below.
+	//
+	auto advance = [&] (float dt, float time)
+	{
+		for (auto & object : classicobjects)
+			object.Advance(dt);
+
+		world.Advance(dt);
+
+		for (auto & object : staticobjects)
+			object.Advance(dt);
+
+		clock.SetTime(time / duration);
+		batch.Advance(dt);
+	};
+
+
+	//
+	// The loop proper. By default every tick is presented as it stands.
+	// With a render rate, ticks run at 1/dt, and frames are presented at
+	// the render rate by blending every object's last two tick values.
+	//
+	auto start = std::chrono::steady_clock::now();
+
+	float time = 0.0f;
+	if (options.RenderRate <= 0.0f)
+	{
+		for (unsigned tick = 0; tick < options.Ticks; ++tick)
+		{
+			time += options.DT;
+			advance(options.DT, time);
+
+			if (renderer)
+			{
+				renderer->BeginFrame(time);
+
+				for (auto & object : classicobjects)
+					object.Render(*renderer);
+
+				for (size_t i = 0; i < world.GetObjectCount(); ++i)
+					world.GetObject(i).Render(*renderer);
+
+				for (auto & object : staticobjects)
+					object.Render(*renderer);
+
+				for (auto & object : reactiveobjects)
+					object.Render(*renderer);
+
+				for (auto & object : batchedobjects)
+					object.Render(*renderer);
+
+				renderer->EndFrame();
+			}
+		}
+	}
+	else
+	{
+		const size_t objectcount = options.Classic + options.Dynamic + options.Static + options.Reactive + options.Batched;
+		const float frametime = 1.0f / options.RenderRate;
+
+		FixedTimestep timestep(options.DT, objectcount);
+
+		unsigned tick = 0;
+
+		auto capture = [&] (float * values)
+		{
+			for (auto & object : classicobjects)
+				*values++ = object.GetPosition();
+			for (size_t i = 0; i < world.GetObjectCount(); ++i)
+				*values++ = world.GetObject(i).GetPosition();
+			for (auto & object : staticobjects)
+				*values++ = object.GetPosition();
+			for (auto & object : reactiveobjects)
+				*values++ = object.GetPosition();
+			batch.GetCurrentValues(0, batch.GetCount(), values);
+		};
+
+		//
+		// The last frame may pay for more steps than are left; those
+		// just hold the final state.
+		//
+		auto step = [&] (float dt, float * values)
+		{
+			if (tick < options.Ticks)
+			{
+				++tick;
+				time += dt;
+				advance(dt, time);
+			}
+
+			capture(values);
+		};
+
+		timestep.Prime(capture);
+
+		float presented = 0.0f;
+		while (tick < options.Ticks)
+		{
+			timestep.Update(frametime, step);
+			presented += frametime;
+
+			const float * values = timestep.Interpolate();
+			if (renderer)
+			{
+				renderer->BeginFrame(presented);
+				for (size_t i = 0; i < objectcount; ++i)
+					renderer->Append("Interpolated object position: ", values[i]);
+				renderer->EndFrame();
+			}
+		}
+	}
+
+	renderer.reset();
+
+	auto end = std::chrono::steady_clock::now();
+
+
+	//
+	// Fold the final state into a checksum, which both keeps the work
+	// observable and lets runs with different settings be compared.
+	//
+	double checksum = 0.0;
+	for (auto & object : classicobjects)
+		checksum += object.GetPosition();
+	for (size_t i = 0; i < world.GetObjectCount(); ++i)
+		checksum += world.GetObject(i).GetPosition();
+	for (auto & object : staticobjects)
+		checksum += object.GetPosition();
+	for (auto & object : reactiveobjects)
+		checksum += object.GetPosition();
+	for (auto & object : batchedobjects)
+		checksum += object.GetPosition();
+
+	const size_t objects = options.Classic + options.Dynamic + options.Static + options.Reactive + options.Batched;
+	const double seconds = std::chrono::duration<double>(end - start).count();
+	const double objectticks = static_cast<double>(objects) * options.Ticks;
+
+	std::fprintf(stderr, "objects %zu, ticks %u, threads %u: %.3f s", objects, options.Ticks, pool.GetWorkerCount(), seconds);
+	if (objectticks > 0.0)
+		std::fprintf(stderr, ", %.3f ns/object/tick", seconds * 1e9 / objectticks);
+	std::fprintf(stderr, ", checksum %.9g\n", checksum);
+
+
+	if (options.Verify)
+	{
+		size_t misplaced = 0;
+		auto check = [&] (const char * design, size_t index, float position)
+		{
+			if (IsOnPath(index, time, position))
+				return;
+
+			if (misplaced++ < 10)
+				std::fprintf(stderr, "%s object %zu ends at %g\n", design, index, position);
+		};
+
+		for (size_t i = 0; i < classicobjects.size(); ++i)
+			check("classic", i, classicobjects[i].GetPosition());
+		for (size_t i = 0; i < world.GetObjectCount(); ++i)
+			check("dynamic", i, world.GetObject(i).GetPosition());
+		for (size_t i = 0; i < staticobjects.size(); ++i)
+			check("static", i, staticobjects[i].GetPosition());
+		for (size_t i = 0; i < reactiveobjects.size(); ++i)
+			check("reactive", i, reactiveobjects[i].GetPosition());
+		for (size_t i = 0; i < batchedobjects.size(); ++i)
+			check("batched", i, batchedobjects[i].GetPosition());
+
+		if (misplaced)
+		{
+			std::fprintf(stderr, "verify: %zu objects off their paths\n", misplaced);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,71 @@
+//
+// Checks for DynamicValueSourceBuckets handle lifetimes.
+//
+// Failures are reported and counted rather than asserted, so the checks
+// still run in release builds.
+//
+
+#include "ValueSourceAccumulator.h"
+#include "ValueSourceBuckets.h"
+
+#include <cstdio>
+
+
+namespace
+{
+
+	int Failures = 0;
+
+	void Check (bool condition, const char * what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "FAILED: %s\n", what);
+			++Failures;
+		}
+	}
+
+
+	//
+	// A second removal through the same handle must leave the bucket
+	// alone: destroying the slot again or freeing it twice would hand the
+	// same slot to two later insertions.
+	//
+	void RemoveTwice ()
+	{
+		DynamicValueSourceBuckets<float> buckets;
+		auto first = buckets.Emplace<ValueSourceLinearAccumulator>(1.0f, 1.0f);
+		auto second = buckets.Emplace<ValueSourceLinearAccumulator>(2.0f, 1.0f);
+
+		Check(buckets.Remove(first), "first removal succeeds");
+		Check(!buckets.Remove(first), "second removal is refused");
+		Check(buckets.GetCount() == 1, "count drops only once");
+		Check(!buckets.IsAlive(first), "removed handle is dead");
+		Check(buckets.IsAlive(second), "other handle is untouched");
+
+		auto third = buckets.Emplace<ValueSourceLinearAccumulator>(3.0f, 1.0f);
+		auto fourth = buckets.Emplace<ValueSourceLinearAccumulator>(4.0f, 1.0f);
+		Check(third.Source != fourth.Source, "freed slot is handed out once");
+		Check(!buckets.IsAlive(first), "reused slot doesn't revive the old handle");
+		Check(!buckets.Remove(first), "old handle can't remove the slot's new source");
+		Check(buckets.GetCount() == 3, "count matches the live sources");
+
+		buckets.Advance(1.0f);
+		Check(buckets.Get(second)->GetCurrentValue() == 3.0f, "second source advanced");
+		Check(buckets.Get(third)->GetCurrentValue() == 4.0f, "third source advanced");
+		Check(buckets.Get(fourth)->GetCurrentValue() == 5.0f, "fourth source advanced");
+	}
+
+}
+
+
+int main ()
+{
+	RemoveTwice();
+
+	if (Failures)
+		return 1;
+
+	std::printf("all bucket checks passed\n");
+	return 0;
+}